@@ -1,64 +1,90 @@
 #include "big_integer.h"
+#include "big_integer_digits.h"
+#include "big_integer_kernels.h"
+#include "big_integer_ntt.h"
 
+#include <cassert>
+#include <cctype>
 #include <cstring>
 #include <stdexcept>
 #include <algorithm>
+#include <istream>
 #include <limits>
+#include <ostream>
+#include <vector>
 
 namespace {
   using limb_t = big_integer::limb_t;
   using dlimb_t = big_integer::dlimb_t;
   const size_t LIMB_T_BITS = std::numeric_limits<limb_t>::digits;
   const limb_t LIMB_T_MAX = std::numeric_limits<limb_t>::max();
-  const limb_t MOD(1000000000);  // for string converting purposes
-  const size_t DECIMAL_DIGIT_LEN = 9;
   // ***helper functions***
 
   limb_t most_significant_bit(limb_t a) {
     return (a >> (LIMB_T_BITS - 1));
   }
 
-  limb_t pow2(limb_t power) {
-    return static_cast<limb_t>(1) << power;
-  }
+  // from this length (in limbs) a string is parsed by halves
+  const size_t FROM_STRING_THRESHOLD = 40;
 
-  limb_t carry(limb_t a, limb_t b, limb_t c = 0) {
-    if (c <= 1) {
-      return LIMB_T_MAX - a >= b && LIMB_T_MAX - a - b >= c ? 0 : 1;
+  void error(bool cond, std::string const &message) {
+    if (cond) {
+      throw std::runtime_error(message);
     }
-    return carry(a, b) + carry(a + b, c);
   }
 
-  limb_t limb_high(limb_t x) {
-    return (x >> (LIMB_T_BITS / 2));
+  // the message is only turned into a string if it is thrown
+  void error(bool cond, char const *message) {
+    if (cond) {
+      throw std::runtime_error(message);
+    }
   }
 
-  limb_t limb_low(limb_t x) {
-    return (x << (LIMB_T_BITS / 2)) >> (LIMB_T_BITS / 2);
+  size_t significant_len(limb_t const *a, size_t n) {
+    while (n > 0 && a[n - 1] == 0) {
+      n--;
+    }
+    return n;
   }
 
-  std::pair<limb_t, limb_t> mul_limb_t(limb_t x, limb_t y) {
-    limb_t a = limb_low(x), b = limb_high(x), c = limb_low(y), d = limb_high(y);
-    limb_t t = a * d + b * c, tc = carry(a * d, b * c);
-    limb_t lo1 = a * c, lo2 = (limb_low(t) << LIMB_T_BITS / 2);
-    // carry(limb_high(t), b * d, carry(lo1, lo2)) == 0
-    // {limb_high, limb_low}
-    return {limb_high(t) + b * d + carry(lo1, lo2) + (tc << LIMB_T_BITS / 2), lo1 + lo2};
-  }
+  const int GREATER = 1;
+  const int EQUAL = 0;
+  const int LESS = -1;
+}
 
-  void error(bool cond, std::string const &message) {
-    if (cond) {
-      throw std::runtime_error(message);
+// a base for string conversion: chunk_base = base^chunk_len is its largest power in a limb;
+// in the power-of-two bases every digit is bits bits of the number
+struct big_integer::radix {
+  limb_t base;
+  unsigned bits;
+  size_t chunk_len;
+  limb_t chunk_base;
+
+  explicit radix(int b) : base(b), bits(0), chunk_len(0), chunk_base(1) {
+    if ((base & (base - 1)) == 0) {
+      while ((limb_t(1) << bits) != base) {
+        bits++;
+      }
+    }
+    while (chunk_base <= LIMB_T_MAX / base) {
+      chunk_base *= base;
+      chunk_len++;
     }
   }
-}
+
+  // at least the number of characters of an n-limb number, with the sign:
+  // B < chunk_base * base, so a limb takes at most chunk_len + 1 digits
+  size_t length_bound(size_t n) const {
+    return bits != 0 ? (n * LIMB_T_BITS + bits - 1) / bits + 1 : n * (chunk_len + 1) + 1;
+  }
+};
 
 bool big_integer::is_negative() const {
-  return most_significant_bit(data_[len() - 1]) == 1;
+  return negative_;
 }
 
-limb_t big_integer::rest_bits() const {
-  return is_negative() ? LIMB_T_MAX : 0;
+bool big_integer::is_zero() const {
+  return len() == 1 && data_[0] == 0;
 }
 
 size_t big_integer::len() const {
@@ -66,23 +92,14 @@ size_t big_integer::len() const {
 }
 
 void big_integer::new_buffer(size_t new_size) {
-  if (len() < new_size) {
-    data_.resize(new_size, rest_bits());
-  } else {
-    data_.resize(new_size);
-  }
+  data_.resize(new_size);
 }
 
 void big_integer::normalize() {
-  if (*this == 0) {
-    return new_buffer(1);
-  }
-  size_t i = len() - 1;
-  while (i > 0) {
-    if (data_[i] != 0) {
-      return new_buffer(i + 1);
-    }
-    i--;
+  auto const &data = data_;
+  new_buffer(std::max(significant_len(data.data(), len()), static_cast<size_t>(1)));
+  if (is_zero()) {
+    negative_ = false;
   }
 }
 
@@ -91,253 +108,965 @@ big_integer::big_integer()
   data_.push_back(0);
 }
 
-big_integer::big_integer(limb_t a) {
-  data_.push_back(a);
-  make_positive();
+big_integer::big_integer(int a) : negative_(a < 0)
+{
+  // |INT_MIN| does not fit in int, but fits in a limb
+  data_.push_back(a < 0 ? -static_cast<limb_t>(a) : static_cast<limb_t>(a));
 }
 
-big_integer::big_integer(int a)
+big_integer::big_integer(limb_t const *limbs, size_t n, bool negative) : negative_(negative)
 {
-  data_.push_back(static_cast<limb_t>(a));
+  new_buffer(std::max(n, static_cast<size_t>(1)));
+  std::copy_n(limbs, n, data_.data());
+  if (n == 0) {
+    data_[0] = 0;
+  }
+  normalize();
 }
 
-big_integer::big_integer(std::string const &str)
+big_integer::big_integer(std::string const &str) : big_integer(str, 10) {}
+
+big_integer::big_integer(std::string const &str, int base)
+    : big_integer(str.data(), str.data() + str.size(), base) {}
+
+big_integer::big_integer(char const *first, char const *last, int base)
 {
-  bool sign = (str[0] == '-');
-  error(str.find_first_not_of("0123456789", sign ? 1 : 0) != std::string::npos
-        || str.size() <= (sign ? 1 : 0),
-        "invalid string for big_integer constructor: " + str);
-  data_.push_back(0);
-  for (size_t i = sign ? 1 : 0; i < str.size(); i += DECIMAL_DIGIT_LEN) {
-    if (str.size() - i >= DECIMAL_DIGIT_LEN) {
-      mul_short(MOD);
-    } else {
-      mul_short(std::stoi("1" + std::string(str.size() - i, '0')));
+  error(base < 2 || base > 36, "big_integer: the base must be in [2, 36]");
+  radix r(base);
+  char const *begin = first;
+  bool sign = first != last && *first == '-';
+  first += sign ? 1 : 0;
+  size_t n = last - first;
+  bool valid;
+  if (r.bits != 0) {
+    valid = n > 0 && parse_pow2(first, last, r);
+  } else if (n < FROM_STRING_THRESHOLD * r.chunk_len) {
+    valid = n > 0 && parse_digits(first, last, r);
+  } else {
+    // the powers are squared while they have fewer digits than the string
+    std::vector<big_integer> powers;
+    big_integer power;
+    power.data_[0] = r.chunk_base;
+    powers.push_back(power);
+    while ((r.chunk_len << powers.size()) < n) {
+      power *= power;
+      powers.push_back(power);
     }
-    make_positive();
-    *this += std::stoi(str.substr(i, DECIMAL_DIGIT_LEN));
+    valid = parse_digits(first, last, r, powers);
   }
-  if (sign) {
-    negate();
+  if (!valid) {
+    // the message copies the whole string, so it is only built for invalid ones
+    error(true, "invalid string for big_integer constructor: " + std::string(begin, last));
   }
+  negative_ = sign;
+  normalize();
 }
 
-big_integer::~big_integer()
+// clearing data_ here would unshare (copy) a copy-on-write buffer just to drop it
+big_integer::big_integer(big_integer &&other) noexcept
+    : data_(std::move(other.data_)), negative_(other.negative_) {}
+
+big_integer& big_integer::operator=(big_integer &&other) noexcept
 {
-  data_.clear();
+  data_ = std::move(other.data_);
+  negative_ = other.negative_;
+  return *this;
 }
 
+big_integer::~big_integer() = default;
+
 // ***subtraction and addition***
 
-void big_integer::add_on_pref(big_integer const &rhs, size_t at) {
-  bool same_sign = rhs.is_negative() == is_negative();
-  new_buffer(std::max(len(), rhs.len() + at));
-  auto carry_bit = 0;
-  for (size_t i = at; i < len(); i++) {
-    limb_t rhs_digit = i - at < rhs.len() ? rhs.data_[i - at] : rhs.rest_bits();
-    auto new_carry = carry(data_[i], rhs_digit, carry_bit);
-    data_[i] += rhs_digit + carry_bit;
-    carry_bit = new_carry;
-  }
-  // "overflow" case
-  if (same_sign) {
-    if ((carry_bit != 0 || is_negative()) && !rhs.is_negative()) {
-      data_.push_back(carry_bit);
+int big_integer::compare_magnitudes(big_integer const &rhs) const {
+  if (len() != rhs.len()) {
+    return len() < rhs.len() ? LESS : GREATER;
+  }
+  return limbs::cmp(data_.data(), rhs.data_.data(), len());
+}
+
+// *this += (rhs_negative ? -|rhs| : |rhs|)
+void big_integer::add_signed(big_integer const &rhs, bool rhs_negative) {
+  if (negative_ == rhs_negative) {
+    if (&rhs == this) {
+      *this <<= 1;
+      return;
+    }
+    if (len() < rhs.len()) {
+      new_buffer(rhs.len());
     }
-    if (rhs.is_negative() && !is_negative()) {
-      data_.push_back(LIMB_T_MAX);
+    limb_t carry_bit = limbs::add(data_.data(), data_.data(), len(), rhs.data_.data(), rhs.len());
+    if (carry_bit != 0) {
+      data_.push_back(carry_bit);
     }
+    return;
   }
+  // the signs differ: subtract the smaller magnitude from the larger one
+  int cmp = compare_magnitudes(rhs);
+  if (cmp == GREATER) {
+    limbs::sub(data_.data(), data_.data(), len(), rhs.data_.data(), rhs.len());
+  } else if (cmp == LESS) {
+    size_t old_len = len();
+    new_buffer(rhs.len());
+    limbs::sub(data_.data(), rhs.data_.data(), rhs.len(), data_.data(), old_len);
+    negative_ = rhs_negative;
+  } else {
+    *this = 0;
+  }
+  normalize();
 }
 
 big_integer& big_integer::operator+=(big_integer const &rhs)
 {
-  add_on_pref(rhs, 0);
+  add_signed(rhs, rhs.negative_);
   return *this;
 }
 
 big_integer& big_integer::operator-=(big_integer const &rhs)
 {
-  return *this += -rhs;
+  add_signed(rhs, !rhs.negative_);
+  return *this;
 }
 
 // ***multiplication***
 
+namespace {
+  // crossover points (in limbs of the shorter operand) between multiplication algorithms:
+  // schoolbook -> Karatsuba -> Toom-3 -> Toom-4 -> NTT
+  const size_t KARATSUBA_THRESHOLD = 32;
+  const size_t TOOM3_THRESHOLD = 300;
+  const size_t TOOM4_THRESHOLD = 800;
+  const size_t NTT_THRESHOLD = 6000;
+  // squaring computes each cross product once, so its basecase stays faster for longer
+  const size_t SQR_KARATSUBA_THRESHOLD = 48;
+
+  void mul_magnitudes(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m);
+  void sqr_magnitudes(limb_t *r, limb_t const *a, size_t n);
+
+  // r[0, n + m) = a[0, n) * b[0, m), n >= m
+  void mul_basecase(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m) {
+    if (m == 0) {
+      std::fill_n(r, n, 0);
+      return;
+    }
+    r[n] = limbs::mul_1(r, a, n, b[0]);
+    for (size_t j = 1; j < m; j++) {
+      r[n + j] = limbs::addmul_1(r + j, a, n, b[j]);
+    }
+  }
+
+  // a = a0 + a1 * B^h, b = b0 + b1 * B^h
+  // a * b = z0 + ((a0 + a1) * (b0 + b1) - z0 - z2) * B^h + z2 * B^2h
+  // requires h < m <= n, where h = ceil(n / 2)
+  void mul_karatsuba(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m) {
+    size_t h = (n + 1) / 2;
+    mul_magnitudes(r, a, h, b, h);
+    mul_magnitudes(r + 2 * h, a + h, n - h, b + h, m - h);
+
+    std::vector<limb_t> sa(h + 1), sb(h + 1);
+    sa[h] = limbs::add(sa.data(), a, h, a + h, n - h);
+    sb[h] = limbs::add(sb.data(), b, h, b + h, m - h);
+    size_t sa_len = significant_len(sa.data(), h + 1);
+    size_t sb_len = significant_len(sb.data(), h + 1);
+
+    // z0, z2 <= (a0 + a1) * (b0 + b1), so their significant limbs fit in mid
+    std::vector<limb_t> mid(sa_len + sb_len);
+    mul_magnitudes(mid.data(), sa.data(), sa_len, sb.data(), sb_len);
+    limbs::sub(mid.data(), mid.data(), mid.size(), r, significant_len(r, 2 * h));
+    limbs::sub(mid.data(), mid.data(), mid.size(), r + 2 * h, significant_len(r + 2 * h, n + m - 2 * h));
+    limbs::add(r + h, r + h, n + m - h, mid.data(), significant_len(mid.data(), mid.size()));
+  }
+
+  // r[0, 2n) = a[0, n)^2
+  // sum(a_i * a_j * B^(i + j)) = 2 * sum_{i < j}(a_i * a_j * B^(i + j)) + sum(a_i^2 * B^2i)
+  void sqr_basecase(limb_t *r, limb_t const *a, size_t n) {
+    if (n == 0) {
+      return;
+    }
+    std::fill_n(r, 2 * n, 0);
+    for (size_t i = 0; i + 1 < n; i++) {
+      r[i + n] = limbs::addmul_1(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+    }
+    limbs::lshift(r, r, 2 * n, 1);
+    limb_t carry_bit = 0;
+    for (size_t i = 0; i < n; i++) {
+      dlimb_t sq = static_cast<dlimb_t>(a[i]) * a[i];
+      dlimb_t low = static_cast<dlimb_t>(r[2 * i]) + static_cast<limb_t>(sq) + carry_bit;
+      dlimb_t high = static_cast<dlimb_t>(r[2 * i + 1]) + static_cast<limb_t>(sq >> LIMB_T_BITS)
+                     + static_cast<limb_t>(low >> LIMB_T_BITS);
+      r[2 * i] = static_cast<limb_t>(low);
+      r[2 * i + 1] = static_cast<limb_t>(high);
+      carry_bit = static_cast<limb_t>(high >> LIMB_T_BITS);
+    }
+  }
+
+  // a^2 = z0 + ((a0 + a1)^2 - z0 - z2) * B^h + z2 * B^2h, where z0 = a0^2, z2 = a1^2
+  void sqr_karatsuba(limb_t *r, limb_t const *a, size_t n) {
+    size_t h = (n + 1) / 2;
+    sqr_magnitudes(r, a, h);
+    sqr_magnitudes(r + 2 * h, a + h, n - h);
+
+    std::vector<limb_t> sa(h + 1);
+    sa[h] = limbs::add(sa.data(), a, h, a + h, n - h);
+    size_t sa_len = significant_len(sa.data(), h + 1);
+
+    std::vector<limb_t> mid(2 * sa_len);
+    sqr_magnitudes(mid.data(), sa.data(), sa_len);
+    limbs::sub(mid.data(), mid.data(), mid.size(), r, significant_len(r, 2 * h));
+    limbs::sub(mid.data(), mid.data(), mid.size(), r + 2 * h, significant_len(r + 2 * h, 2 * n - 2 * h));
+    limbs::add(r + h, r + h, 2 * n - h, mid.data(), significant_len(mid.data(), mid.size()));
+  }
+
+  // ***two's complement arithmetic on fixed-width scratch buffers***
+  // Toom-Cook evaluation and interpolation produce negative intermediate values,
+  // so they are kept modulo B^n with enough spare high limbs to hold the sign
+
+  bool is_negative_n(limb_t const *a, size_t n) {
+    return most_significant_bit(a[n - 1]) == 1;
+  }
+
+  // r[0, n) += a[0, m) * factor (mod B^n), m <= n, a is zero-extended
+  void addmul_signed_n(limb_t *r, size_t n, limb_t const *a, size_t m, int factor) {
+    if (factor > 0) {
+      limb_t c = limbs::addmul_1(r, a, m, static_cast<limb_t>(factor));
+      limbs::add_1(r + m, r + m, n - m, c);
+    } else if (factor < 0) {
+      limb_t c = limbs::submul_1(r, a, m, static_cast<limb_t>(-factor));
+      limbs::sub_1(r + m, r + m, n - m, c);
+    }
+  }
+
+  // a[0, n) /= divisor, the division must be exact
+  void div_exact_signed_n(limb_t *a, size_t n, int divisor) {
+    if (divisor < 0) {
+      limbs::neg(a, a, n);
+      divisor = -divisor;
+    }
+    auto d = static_cast<limb_t>(divisor);
+    size_t shift = 0;
+    while (d % 2 == 0) {
+      d /= 2, shift++;
+    }
+    if (shift > 0) {
+      limb_t fill_value = is_negative_n(a, n) ? LIMB_T_MAX : 0;
+      for (size_t i = 0; i < n; i++) {
+        limb_t next = i + 1 < n ? a[i + 1] : fill_value;
+        a[i] = (a[i] >> shift) | (next << (LIMB_T_BITS - shift));
+      }
+    }
+    if (d == 1) {
+      return;
+    }
+    // d * inv == 1 (mod B), each Newton step doubles the number of correct low bits
+    limb_t inv = d;
+    for (size_t correct_bits = 3; correct_bits < LIMB_T_BITS; correct_bits *= 2) {
+      inv *= 2 - d * inv;
+    }
+    limb_t borrow = 0;
+    for (size_t i = 0; i < n; i++) {
+      limb_t new_borrow = a[i] < borrow ? 1 : 0;
+      limb_t q = (a[i] - borrow) * inv;
+      a[i] = q;
+      borrow = static_cast<limb_t>((static_cast<dlimb_t>(q) * d) >> LIMB_T_BITS) + new_borrow;
+    }
+  }
+
+  // ***Toom-Cook***
+  // a and b are split into ka and kb pieces of l limbs, a(x) * b(x) is evaluated
+  // in ka + kb - 2 small integer points and in infinity, then interpolated
+  const int TOOM_POINTS[] = {0, 1, -1, 2, -2, 3, -3};
+
+  // v[0, width) = sum(a_i * x^i), where a_i = a[i * l, min((i + 1) * l, n))
+  void toom_evaluate(limb_t *v, size_t width, limb_t const *a, size_t n, size_t l, int x) {
+    std::fill_n(v, width, 0);
+    int power = 1;
+    for (size_t i = 0; i * l < n && power != 0; i++, power *= x) {
+      addmul_signed_n(v, width, a + i * l, std::min(l, n - i * l), power);
+    }
+  }
+
+  // r[0, width) = a * b, where a and b are signed numbers of a_width limbs, a may be the same as b
+  void toom_mul_signed(limb_t *r, size_t width, limb_t *a, limb_t *b, size_t a_width) {
+    bool sign = is_negative_n(a, a_width) ^ is_negative_n(b, a_width);
+    if (is_negative_n(a, a_width)) {
+      limbs::neg(a, a, a_width);
+    }
+    if (is_negative_n(b, a_width)) {
+      limbs::neg(b, b, a_width);
+    }
+    std::fill_n(r, width, 0);
+    size_t a_len = significant_len(a, a_width), b_len = significant_len(b, a_width);
+    if (a_len > 0 && b_len > 0) {
+      mul_magnitudes(r, a, a_len, b, b_len);
+    }
+    if (sign) {
+      limbs::neg(r, r, width);
+    }
+  }
+
+  void mul_toom(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m, size_t k) {
+    size_t l = (n + k - 1) / k;
+    size_t ka = (n + l - 1) / l, kb = (m + l - 1) / l;
+    size_t deg = ka + kb - 2;
+    size_t eval_width = l + 1, width = 2 * l + 3;
+
+    // coeff[i] holds the value in TOOM_POINTS[i] for i < deg, coeff[deg] is the leading coefficient
+    std::vector<limb_t> coeff((deg + 1) * width);
+    bool square = a == b && n == m;
+    std::vector<limb_t> va(eval_width), vb(eval_width);
+    for (size_t i = 0; i < deg; i++) {
+      toom_evaluate(va.data(), eval_width, a, n, l, TOOM_POINTS[i]);
+      if (!square) {
+        toom_evaluate(vb.data(), eval_width, b, m, l, TOOM_POINTS[i]);
+      }
+      toom_mul_signed(&coeff[i * width], width, va.data(), square ? va.data() : vb.data(), eval_width);
+    }
+    limb_t *top = &coeff[deg * width];
+    size_t a_top = n - (ka - 1) * l, b_top = m - (kb - 1) * l;
+    mul_magnitudes(top, a + (ka - 1) * l, a_top, b + (kb - 1) * l, b_top);
+    std::fill(top + a_top + b_top, top + width, 0);
+
+    // remove the leading term, the rest is a polynomial of degree deg - 1 known in deg points
+    for (size_t i = 0; i < deg; i++) {
+      int power = 1;
+      for (size_t j = 0; j < deg; j++) {
+        power *= TOOM_POINTS[i];
+      }
+      addmul_signed_n(&coeff[i * width], width, top, width, -power);
+    }
+
+    // Newton's divided differences, they are integers for a polynomial with integer coefficients
+    for (size_t j = 1; j < deg; j++) {
+      for (size_t i = deg; i --> j;) {
+        limbs::sub_n(&coeff[i * width], &coeff[i * width], &coeff[(i - 1) * width], width);
+        div_exact_signed_n(&coeff[i * width], width, TOOM_POINTS[i] - TOOM_POINTS[i - j]);
+      }
+    }
+
+    // Newton form -> monomial form, by Horner's scheme:
+    // p(x) = d_0 + (x - x_0) * (d_1 + (x - x_1) * (...))
+    for (size_t i = deg - 1; i --> 0;) {
+      // coeff[i + 1, deg) *= (x - x_i), coeff[i] holds d_i and becomes the new constant term
+      for (size_t j = i + 1; j < deg; j++) {
+        addmul_signed_n(&coeff[(j - 1) * width], width, &coeff[j * width], width, -TOOM_POINTS[i]);
+      }
+    }
+
+    std::fill_n(r, n + m, 0);
+    for (size_t i = 0; i <= deg; i++) {
+      limb_t const *c = &coeff[i * width];
+      assert(!is_negative_n(c, width));
+      limbs::add(r + i * l, r + i * l, n + m - i * l, c, std::min(significant_len(c, width), n + m - i * l));
+    }
+  }
+
+  // |b| is much shorter than |a|: multiply b by slices of a of its own length
+  void mul_unbalanced(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m) {
+    std::fill_n(r, n + m, 0);
+    std::vector<limb_t> part(2 * m);
+    for (size_t i = 0; i < n; i += m) {
+      size_t slice = std::min(m, n - i);
+      mul_magnitudes(part.data(), a + i, slice, b, m);
+      limbs::add(r + i, r + i, n + m - i, part.data(), slice + m);
+    }
+  }
+
+  // r[0, n + m) = a[0, n) * b[0, m), r must not overlap with a or b
+  void mul_magnitudes(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m) {
+    if (a == b && n == m) {
+      return sqr_magnitudes(r, a, n);
+    }
+    if (n < m) {
+      std::swap(a, b);
+      std::swap(n, m);
+    }
+    if (m < KARATSUBA_THRESHOLD) {
+      mul_basecase(r, a, n, b, m);
+    } else if (m <= (n + 1) / 2) {
+      mul_unbalanced(r, a, n, b, m);
+    } else if (m < TOOM3_THRESHOLD) {
+      mul_karatsuba(r, a, n, b, m);
+    } else if (m < TOOM4_THRESHOLD) {
+      mul_toom(r, a, n, b, m, 3);
+    } else if (m < NTT_THRESHOLD || !ntt_fits(n, m)) {
+      mul_toom(r, a, n, b, m, 4);
+    } else {
+      ntt_mul(r, a, n, b, m);
+    }
+  }
+
+  // r[0, 2n) = a[0, n)^2, r must not overlap with a
+  void sqr_magnitudes(limb_t *r, limb_t const *a, size_t n) {
+    if (n < SQR_KARATSUBA_THRESHOLD) {
+      sqr_basecase(r, a, n);
+    } else if (n < TOOM3_THRESHOLD) {
+      sqr_karatsuba(r, a, n);
+    } else if (n < TOOM4_THRESHOLD) {
+      mul_toom(r, a, n, a, n, 3);
+    } else if (n < NTT_THRESHOLD || !ntt_fits(n, n)) {
+      mul_toom(r, a, n, a, n, 4);
+    } else {
+      ntt_mul(r, a, n, a, n);
+    }
+  }
+}
+
 big_integer& big_integer::operator*=(big_integer const &rhs)
 {
-  bool sign = is_negative() ^ rhs.is_negative();
-  auto a = make_abs();
-  auto b(rhs);
-  b.make_abs();
-
-  b.normalize();
-  a.normalize();
-  *this = 0;
-  new_buffer(a.len() + b.len() + 1);
-  for (size_t i = 0; i < a.len(); i++) {
-    limb_t carry_num = 0;
-    for (size_t j = 0; j < b.len(); j++) {
-      auto t1 = mul_limb_t(a.data_[i], b.data_[j]);
-      auto t2 = data_[i + j];
-      data_[i + j] += t1.second + carry_num;
-      carry_num = t1.first + carry(carry_num, t2, t1.second);
-    }
-    data_[i + b.len()] += carry_num;
+  // the magnitudes are multiplied in place; a square is detected by mul_magnitudes,
+  // since x *= x and copies of x share their limbs
+  auto const &data = data_;
+  decltype(data_) res;
+  res.resize(len() + rhs.len());
+  mul_magnitudes(res.data(), data.data(), len(), rhs.data_.data(), rhs.len());
+  data_.swap(res);
+  negative_ = negative_ != rhs.negative_;
+  normalize();
+  return *this;
+}
+
+// ***fused sums of products***
+
+namespace {
+  // a magnitude taking part in a sum, subtracted if flip is all ones
+  struct summand
+  {
+    limb_t const *p;
+    size_t n;
+    limb_t flip;
+  };
+
+  // r[0, n) = the sum of the summands modulo B^n in one pass: a subtracted limb x is added
+  // as ~x = B - 1 - x, and the k subtracted summands make up for the k * (B - 1) this adds
+  // by starting the carry at k, so that the carry never goes negative
+  void sum_summands(limb_t *r, size_t n, summand const *s, size_t k) {
+    size_t common = n;
+    dlimb_t carry = 0;
+    for (summand const *x = s; x != s + k; x++) {
+      common = std::min(common, x->n);
+      carry += x->flip & 1;
+    }
+    for (size_t i = 0; i < common; i++) {
+      for (summand const *x = s; x != s + k; x++) {
+        carry += x->p[i] ^ x->flip;
+      }
+      r[i] = static_cast<limb_t>(carry);
+      carry >>= LIMB_T_BITS;
+    }
+    for (size_t i = common; i < n; i++) {
+      for (summand const *x = s; x != s + k; x++) {
+        carry += (i < x->n ? x->p[i] : 0) ^ x->flip;
+      }
+      r[i] = static_cast<limb_t>(carry);
+      carry >>= LIMB_T_BITS;
+    }
+  }
+
+  // r[0, n) += or -= a[0, a_len) * b[0, b_len) modulo B^n, n > a_len + b_len - 1
+  void addmul_rows(limb_t *r, size_t n, limb_t const *a, size_t a_len,
+                   limb_t const *b, size_t b_len, bool negative) {
+    for (size_t j = 0; j < b_len; j++) {
+      limb_t *row = r + j;
+      if (negative) {
+        limb_t borrow = limbs::submul_1(row, a, a_len, b[j]);
+        limbs::sub_1(row + a_len, row + a_len, n - j - a_len, borrow);
+      } else {
+        limb_t carry = limbs::addmul_1(row, a, a_len, b[j]);
+        limbs::add_1(row + a_len, row + a_len, n - j - a_len, carry);
+      }
+    }
+  }
+}
+
+big_integer& big_integer::assign_sum(sum_term const *terms, size_t n)
+{
+  // n < B / 2 summands below B^(width - 1) keep the sum in (-B^width / 2, B^width / 2),
+  // so it is computed modulo B^width and the top bit gives the sign
+  size_t width = 0;
+  for (size_t i = 0; i < n; i++) {
+    big_integer const *a = terms[i].a, *b = terms[i].b;
+    if (a == this || b == this) {
+      big_integer res;
+      res.assign_sum(terms, n);
+      return *this = std::move(res);
+    }
+    width = std::max(width, a->len() + (b != nullptr ? b->len() : 0));
+  }
+  width++;
+
+  // products below the Karatsuba threshold are added row by row after the sum, the others
+  // become summands; a few summands are kept on the stack
+  auto apart = [](big_integer const *a, big_integer const *b) {
+    return std::min(a->len(), b->len()) >= KARATSUBA_THRESHOLD;
+  };
+  std::vector<limb_t> products;
+  for (size_t i = 0; i < n; i++) {
+    big_integer const *a = terms[i].a, *b = terms[i].b;
+    if (b != nullptr && apart(a, b)) {
+      products.resize(products.size() + a->len() + b->len());
+    }
+  }
+  summand local[8];
+  std::vector<summand> heap(n > 8 ? n : 0);
+  summand *summands = n > 8 ? heap.data() : local;
+  size_t k = 0, offset = 0;
+  for (size_t i = 0; i < n; i++) {
+    big_integer const *a = terms[i].a, *b = terms[i].b;
+    bool negative = terms[i].negative != a->negative_;
+    if (b == nullptr) {
+      summands[k++] = {a->data_.data(), a->len(), negative ? ~limb_t(0) : 0};
+    } else if (apart(a, b)) {
+      limb_t *p = products.data() + offset;
+      mul_magnitudes(p, a->data_.data(), a->len(), b->data_.data(), b->len());
+      summands[k++] = {p, a->len() + b->len(), negative != b->negative_ ? ~limb_t(0) : 0};
+      offset += a->len() + b->len();
+    }
+  }
+
+  new_buffer(width);
+  limb_t *r = data_.data();
+  sum_summands(r, width, summands, k);
+  for (size_t i = 0; i < n; i++) {
+    big_integer const *a = terms[i].a, *b = terms[i].b;
+    if (b != nullptr && !apart(a, b)) {
+      if (a->len() < b->len()) {
+        std::swap(a, b);
+      }
+      addmul_rows(r, width, a->data_.data(), a->len(), b->data_.data(), b->len(),
+                  terms[i].negative != (a->negative_ != b->negative_));
+    }
+  }
+  negative_ = most_significant_bit(r[width - 1]) == 1;
+  if (negative_) {
+    limbs::neg(r, r, width);
   }
   normalize();
-  make_positive();
-  return sign ? negate() : *this;
+  return *this;
 }
 
 // ***division***
 
+size_t big_integer::div_newton_threshold = 120000;
+
 namespace {
   dlimb_t glue(limb_t x1, limb_t x0) {
     return (static_cast<dlimb_t>(x1) << LIMB_T_BITS) | x0;
   }
-}
 
-// source: www.youtube.com/channel/UCzymTLlAXdcgRn6yLcpow0Q
-limb_t get_approx(big_integer const &a, big_integer const &b) {
-  limb_t u2 = a.data_[2], u1 = a.data_[1], u0 = a.data_[0];
-  limb_t d1 = b.data_[1], d0 = b.data_[0];
-  dlimb_t numer = glue(u2, u1);
-  dlimb_t denom = glue(d1, d0);
-  if (u2 == d1) {
-    dlimb_t S = glue(d0 - u1, 0) - u0;
-    return S <= denom ? LIMB_T_MAX : LIMB_T_MAX - 1;
+  limb_t high_limb(dlimb_t x) {
+    return static_cast<limb_t>(x >> LIMB_T_BITS);
   }
-  dlimb_t quot_approx = numer / d1;
-  dlimb_t err = quot_approx * d0;
-  dlimb_t rem_approx = glue(numer - quot_approx * d1, u0);
-  if (rem_approx < err) {
-    quot_approx--, rem_approx += denom;
-    if (rem_approx >= denom && rem_approx < err) {
-      quot_approx--, rem_approx += denom;
+
+  // the shift that sets the top bit of a nonzero d
+  unsigned normalizing_shift(limb_t d) {
+    unsigned shift = 0;
+    while (most_significant_bit(d << shift) == 0) {
+      shift++;
     }
+    return shift;
   }
-  return quot_approx;
-}
 
-void big_integer::mul_short(limb_t short_factor) {  // slightly faster version of `*=` for division
-  limb_t carry_num = 0;
-  for (size_t j = 0; j < len(); j++) {
-    auto t = mul_limb_t(short_factor, data_[j]);
-    data_[j] = t.second + carry_num;
-    carry_num = t.first + carry(carry_num, t.second);
+  // Division by invariant integers, after Moller and Granlund, "Improved division by invariant
+  // integers": a quotient digit is computed with two multiplications by a precomputed inverse
+  // of the (normalized) divisor instead of a hardware division.
+
+  // v = (B^2 - 1) / d - B, the top bit of d is set
+  limb_t inverse_2by1(limb_t d) {
+    return static_cast<limb_t>(~glue(d, 0) / d);
   }
-  if (carry_num != 0) {
-    data_.push_back(carry_num);
+
+  // v = (B^3 - 1) / {d1, d0} - B, the top bit of d1 is set
+  limb_t inverse_3by2(limb_t d1, limb_t d0) {
+    limb_t v = inverse_2by1(d1);
+    limb_t p = static_cast<limb_t>(d1 * v + d0);
+    if (p < d0) {
+      v--;
+      if (p >= d1) {
+        v--;
+        p -= d1;
+      }
+      p -= d1;
+    }
+    dlimb_t t = static_cast<dlimb_t>(v) * d0;
+    p += high_limb(t);
+    if (p < high_limb(t)) {
+      v--;
+      if (glue(p, static_cast<limb_t>(t)) >= glue(d1, d0)) {
+        v--;
+      }
+    }
+    return v;
   }
-}
 
-void big_integer::prefix(size_t pref_len, big_integer &ans) {
-  ans.new_buffer(pref_len);
-  for (size_t i = 0; i < pref_len; i++) {
-    ans.data_[i] = len() < pref_len - i ? 0 : data_[len() - pref_len + i];
+  // {u1, u0} / d, u1 < d, v = inverse_2by1(d); rem receives the remainder
+  limb_t div_2by1(limb_t &rem, limb_t u1, limb_t u0, limb_t d, limb_t v) {
+    dlimb_t q = static_cast<dlimb_t>(v) * u1 + glue(u1, u0);
+    limb_t q1 = high_limb(q) + 1;
+    limb_t r = static_cast<limb_t>(u0 - q1 * d);
+    // this adjustment is taken about half of the time, so it is done with a mask
+    limb_t mask = -static_cast<limb_t>(r > static_cast<limb_t>(q));
+    q1 += mask;
+    r += mask & d;
+    if (r >= d) {
+      q1++;
+      r -= d;
+    }
+    rem = r;
+    return q1;
   }
-}
 
-namespace {
-  const int GREATER = 1;
-  const int EQUAL = 0;
-  const int LESS = -1;
-}
+  // {u2, u1, u0} / {d1, d0}, {u2, u1} < {d1, d0}, v = inverse_3by2(d1, d0)
+  limb_t div_3by2(limb_t u2, limb_t u1, limb_t u0, limb_t d1, limb_t d0, limb_t v) {
+    dlimb_t q = static_cast<dlimb_t>(v) * u2 + glue(u2, u1);
+    limb_t q1 = high_limb(q);
+    dlimb_t d = glue(d1, d0);
+    dlimb_t r = glue(static_cast<limb_t>(u1 - q1 * d1), u0) - d - static_cast<dlimb_t>(d0) * q1;
+    q1++;
+    limb_t mask = -static_cast<limb_t>(high_limb(r) >= static_cast<limb_t>(q));
+    q1 += mask;
+    r += d & glue(mask, mask);
+    if (r >= d) {
+      q1++;
+    }
+    return q1;
+  }
 
-int big_integer::compare_lexicographically(
-        big_integer const &rhs,
-        limb_t fill_value, size_t at) const {
-  for (size_t i = std::max(len(), rhs.len()); i --> at;) {
-    limb_t a = i < len() ? data_[i] : fill_value;
-    limb_t b = i < rhs.len() ? rhs.data_[i] : fill_value;
-    if (a == b) {
-      continue;
+  // q[0, n) = a[0, n) / (d >> shift), returns the remainder; d has its top bit set
+  // and v = inverse_2by1(d); q may be the same as a
+  limb_t div_1_preinv(limb_t *q, limb_t const *a, size_t n, limb_t d, unsigned shift, limb_t v) {
+    if (shift == 0) {
+      limb_t rem = 0;
+      for (size_t i = n; i --> 0;) {
+        q[i] = div_2by1(rem, rem, a[i], d, v);
+      }
+      return rem;
+    }
+    // a is shifted on the fly, the remainder stays scaled by 2^shift until the end
+    limb_t rem = a[n - 1] >> (LIMB_T_BITS - shift);
+    for (size_t i = n - 1; i --> 0;) {
+      limb_t u0 = (a[i + 1] << shift) | (a[i] >> (LIMB_T_BITS - shift));
+      q[i + 1] = div_2by1(rem, rem, u0, d, v);
     }
-    return a > b ? GREATER : LESS;
+    q[0] = div_2by1(rem, rem, a[0] << shift, d, v);
+    return rem >> shift;
   }
-  return EQUAL;
-}
 
-// Not to be confused with abs
-void big_integer::make_positive() {
-  if (is_negative()) {
-    data_.push_back(0);
+  // q[0, n) = a[0, n) / d, returns the remainder; q may be the same as a
+  limb_t div_1(limb_t *q, limb_t const *a, size_t n, limb_t d) {
+    unsigned shift = normalizing_shift(d);
+    return div_1_preinv(q, a, n, d << shift, shift, inverse_2by1(d << shift));
   }
-}
 
-big_integer& big_integer::make_abs() {
-  return is_negative() ? negate() : *this;
-}
+  // crossover point (in quotient limbs) from schoolbook to recursive division
+  const size_t DIV_RECURSIVE_THRESHOLD = 60;
+
+  // The division kernels below share one contract:
+  // q[0, m) = a[0, n + m) / d[0, n), a[0, n) = a[0, n + m) % d[0, n), a[n, n + m) is zeroed.
+  // The top bit of d is set, n >= 2 and m <= n, v = inverse_3by2(d[n - 1], d[n - 2]) (the top
+  // two limbs, and so v, are the same for every part of the divisor the recursion passes down).
+  // The quotient may need one more limb, which is returned (it is 0 or 1, and always 0
+  // if a[m, n + m) < d).
+
+  // Knuth's algorithm D; a quotient digit is estimated from the top three limbs of the partial
+  // remainder, which is never too small and at most 1 too large
+  limb_t div_basecase(limb_t *q, limb_t *a, size_t m, limb_t const *d, size_t n, limb_t v) {
+    limb_t q_top = limbs::cmp(a + m, d, n) >= 0 ? 1 : 0;
+    if (q_top != 0) {
+      limbs::sub_n(a + m, a + m, d, n);
+    }
+    limb_t d1 = d[n - 1], d0 = d[n - 2];
+    for (size_t j = m; j --> 0;) {
+      // the partial remainder is less than d * B, so {u2, u1} <= {d1, d0},
+      // and the digit is B - 1 if they are equal
+      limb_t u2 = a[j + n], u1 = a[j + n - 1];
+      limb_t qt = u2 == d1 && u1 == d0 ? LIMB_T_MAX : div_3by2(u2, u1, a[j + n - 2], d1, d0, v);
+      limb_t borrow = limbs::submul_1(a + j, d, n, qt);
+      limb_t top = a[j + n];
+      a[j + n] = top - borrow;
+      if (top < borrow) {
+        // the estimate was one too large: add the divisor back
+        qt--;
+        a[j + n] += limbs::add_n(a + j, a + j, d, n);
+      }
+      q[j] = qt;
+    }
+    return q_top;
+  }
 
-big_integer& big_integer::operator/=(big_integer const &rhs)
-{
-  error(rhs == 0, "division by zero");
-  bool sign = is_negative() ^ rhs.is_negative();
-  make_abs();
-  big_integer divisor(rhs);
-  divisor.make_abs();
-  if (divisor.compare_lexicographically(*this) == GREATER) {
-    return *this = 0;
+  // a[at, at + n) -= q[0, qn) * d[0, dn) (with the extra quotient limb q_top at qn), then
+  // the quotient is decremented and d[0, n) added back at 'at' until the remainder is not negative
+  void subtract_and_correct(limb_t *a, size_t at, size_t n, limb_t *q, size_t qn, limb_t &q_top,
+                            limb_t const *d, size_t dn, limb_t const *full_d) {
+    std::vector<limb_t> prod(qn + dn);
+    mul_magnitudes(prod.data(), q, qn, d, dn);
+    limb_t borrow = limbs::sub(a + at, a + at, n, prod.data(), qn + dn);
+    if (q_top != 0) {
+      borrow += limbs::sub(a + at + qn, a + at + qn, n - qn, d, dn);
+    }
+    while (borrow != 0) {
+      q_top -= limbs::sub_1(q, q, qn, 1);
+      borrow -= limbs::add_n(a + at, a + at, full_d, n);
+    }
   }
 
-  divisor.normalize();
+  // Burnikel-Ziegler recursive division, as in Brent and Zimmermann, "Modern Computer Arithmetic":
+  // with d = d1 * B^k + d0, the high half of the quotient is estimated by dividing by d1 only and
+  // corrected by subtracting q1 * d0, then the same is done for the low half
+  limb_t div_recursive(limb_t *q, limb_t *a, size_t m, limb_t const *d, size_t n, limb_t v) {
+    if (m < DIV_RECURSIVE_THRESHOLD) {
+      return div_basecase(q, a, m, d, n, v);
+    }
+    size_t k = m / 2;
+    limb_t const *d1 = d + k;
+
+    // q1 = a[2k, n + m) / d1, a[2k, n + k) = remainder
+    limb_t q_top = div_recursive(q + k, a + 2 * k, m - k, d1, n - k, v);
+    subtract_and_correct(a, k, n, q + k, m - k, q_top, d, k, d);
+
+    // q0 = a[k, n + k) / d1, a[k, n) = remainder
+    limb_t q0_top = div_recursive(q, a + k, k, d1, n - k, v);
+    q_top += limbs::add_1(q + k, q + k, m - k, q0_top);
+    limb_t q0_top_left = q0_top;
+    subtract_and_correct(a, 0, n, q, k, q0_top_left, d, k, d);
+    // the corrections of the low half borrow from the high half
+    q_top -= limbs::sub_1(q + k, q + k, m - k, q0_top - q0_top_left);
+    return q_top;
+  }
+
+  // ***division by a Newton reciprocal***
+
+  // x[0, n + 1) = B^2n / d[0, n) up to a few units, the top bit of d is set;
+  // a reciprocal of the top h limbs is refined by one Newton step x += x * (B^2n - d * x) / B^2n;
+  // v is the 3-by-2 inverse of the top two limbs of d
+  void reciprocal(limb_t *x, limb_t const *d, size_t n, limb_t v) {
+    // short divisors get exactly (B^2n - 1) / d, the top limb comes out of div_recursive;
+    // the refinement below needs h < n, that is n >= 4
+    if (n < big_integer::div_newton_threshold || n < 4) {
+      std::vector<limb_t> a(2 * n, LIMB_T_MAX);
+      x[n] = div_recursive(x, a.data(), n, d, n, v);
+      return;
+    }
+    // the error of the refined value is about (error of xh)^2 / B^(2h - n)
+    size_t h = (n + 1) / 2 + 1;
+    std::vector<limb_t> xh(h + 1);
+    reciprocal(xh.data(), d + n - h, h, v);
+
+    // e = B^(n + h) - d * xh, which is (B^2n - d * xh * B^(n - h)) / B^(n - h); |e| < 4 * B^n
+    std::vector<limb_t> e(n + h + 1);
+    mul_magnitudes(e.data(), d, n, xh.data(), h + 1);
+    bool e_negative = e[n + h] != 0;
+    if (e_negative) {
+      e[n + h]--;
+    } else {
+      limbs::neg(e.data(), e.data(), n + h);
+    }
+    size_t e_len = significant_len(e.data(), n + h + 1);
+    assert(e_len <= n + 1);
+
+    // x = xh * B^(n - h) +- xh * e / B^2h; the lowest h - 1 limbs of e change the result
+    // by less than a unit, so they are dropped
+    std::fill_n(x, n - h, 0);
+    std::copy_n(xh.begin(), h + 1, x + n - h);
+    if (e_len < h) {
+      return;
+    }
+    limb_t const *e_top = e.data() + h - 1;
+    size_t e_top_len = e_len - (h - 1);
+    std::vector<limb_t> corr(h + 1 + e_top_len);
+    mul_magnitudes(corr.data(), xh.data(), h + 1, e_top, e_top_len);
+    size_t corr_len = significant_len(corr.data() + h + 1, corr.size() - (h + 1));
+    if (e_negative) {
+      limbs::sub(x, x, n + 1, corr.data() + h + 1, corr_len);
+    } else {
+      limbs::add(x, x, n + 1, corr.data() + h + 1, corr_len);
+    }
+  }
 
-  if (divisor.len() == 1) {
-    div_short(divisor.data_[0]);
-    return sign ? negate() : *this;
+  // same contract as div_recursive, x[0, n + 1) is the reciprocal of d, a[m, n + m) < d;
+  // the quotient estimate (a / B^n) * x / B^n is off by a few units and is corrected
+  void div_newton(limb_t *q, limb_t *a, size_t m, limb_t const *d, size_t n, limb_t const *x) {
+    std::vector<limb_t> qx(m + n + 1);
+    mul_magnitudes(qx.data(), a + n, m, x, n + 1);
+    limb_t *qt = qx.data() + n;  // m + 1 limbs
+
+    std::vector<limb_t> p(m + n + 1);
+    mul_magnitudes(p.data(), d, n, qt, m + 1);
+    while (p[n + m] != 0 || limbs::cmp(p.data(), a, n + m) > 0) {
+      limbs::sub_1(qt, qt, m + 1, 1);
+      limbs::sub(p.data(), p.data(), n + m + 1, d, n);
+    }
+    limbs::sub_n(a, a, p.data(), n + m);
+    while (significant_len(a + n, m) > 0 || limbs::cmp(a, d, n) >= 0) {
+      limbs::sub(a, a, n + m, d, n);
+      limbs::add_1(qt, qt, m + 1, 1);
+    }
+    assert(qt[m] == 0);
+    std::copy_n(qt, m, q);
   }
 
-  limb_t last_digit = divisor.data_.back();
-  limb_t scaling_factor = last_digit == LIMB_T_MAX ?
-                          1 : std::min(glue(0, LIMB_T_MAX), glue(1, 0) / (last_digit + 1));
-  divisor.mul_short(scaling_factor);
-  mul_short(scaling_factor);
-  normalize();
+  // q[0, n - m + 1) = a[0, n) / d, r[0, m) = a[0, n) % d, n >= m >= 2, where d = dn >> shift,
+  // the top bit of dn[0, m) is set and v is the 3-by-2 inverse of its top two limbs;
+  // x[0, m + 1) is the Newton reciprocal of dn or null, u is scratch space for n + 1 limbs
+  void divmod_scaled(limb_t *q, limb_t *r, limb_t const *a, size_t n,
+                     limb_t const *dn, size_t m, unsigned shift, limb_t v, limb_t const *x, limb_t *u) {
+    // u is the scaled dividend, which the quotient loops turn into the remainder in place
+    if (shift > 0) {
+      u[n] = limbs::lshift(u, a, n, shift);
+    } else {
+      std::copy_n(a, n, u);
+      u[n] = 0;
+    }
+    // the quotient is produced from the top in blocks of at most m limbs,
+    // each block divides a window of the partial remainder that is less than d * B^block
+    size_t qn = n - m + 1;
+    while (qn > 0) {
+      size_t block = qn % m == 0 ? m : qn % m;
+      qn -= block;
+      if (x != nullptr) {
+        div_newton(q + qn, u + qn, block, dn, m, x);
+      } else {
+        limb_t q_top = div_recursive(q + qn, u + qn, block, dn, m, v);
+        assert(q_top == 0);
+        (void) q_top;
+      }
+    }
+    if (shift > 0) {
+      limbs::rshift(r, u, m, shift);
+    } else {
+      std::copy_n(u, m, r);
+    }
+  }
 
-  big_integer quot;
-  quot.new_buffer(len() - divisor.len() + 1);
-  data_.push_back(0);
+  bool use_newton(size_t n, size_t m) {
+    return m >= big_integer::div_newton_threshold && n - m + 1 >= big_integer::div_newton_threshold;
+  }
 
-  big_integer div2, rem3, res;
-  divisor.prefix(2, div2);
-  for (size_t i = quot.len(); i --> 0 ;) {
-    prefix(3, rem3);
-    limb_t qt = get_approx(rem3, div2);
-
-    res = divisor;
-    res.mul_short(qt);
-    res.make_positive();
-
-    if (compare_lexicographically(res, 0,len() - divisor.len() - 1) == LESS) {
-      qt--;
-      divisor.make_positive();
-      res -= divisor;
-      divisor.normalize();
-    }
-
-    quot.data_[i] = qt;
-    res.negate();
-    if (is_negative()) {
-      make_positive();
-      add_on_pref(res, len() - res.len());
-      new_buffer(len() - 1);
+  // q[0, n - m + 1) = a[0, n) / d[0, m), r[0, m) = a[0, n) % d[0, m), n >= m, d[m - 1] != 0
+  void divmod_magnitudes(limb_t *q, limb_t *r, limb_t const *a, size_t n, limb_t const *d, size_t m) {
+    if (m == 1) {
+      r[0] = div_1(q, a, n, d[0]);
+      return;
+    }
+    // a single scratch buffer holds the scaled divisor dn and the scaled dividend
+    std::vector<limb_t> scratch(m + n + 1);
+    limb_t *dn = scratch.data();
+    unsigned shift = normalizing_shift(d[m - 1]);
+    if (shift > 0) {
+      limbs::lshift(dn, d, m, shift);
     } else {
-      add_on_pref(res, len() - res.len());
+      std::copy_n(d, m, dn);
+    }
+    limb_t v = inverse_3by2(dn[m - 1], dn[m - 2]);
+    std::vector<limb_t> x;
+    if (use_newton(n, m)) {
+      x.resize(m + 1);
+      reciprocal(x.data(), dn, m, v);
     }
-    if (len() > 1) {
-      new_buffer(len() - 1);
+    divmod_scaled(q, r, a, n, dn, m, shift, v, x.empty() ? nullptr : x.data(), dn + m);
+  }
+}
+
+big_integer_divisor::big_integer_divisor(big_integer const &d)
+    : value_(d), scaled_(d.len()), shift_(0), inverse_(0)
+{
+  error(d.is_zero(), "division by zero");
+  size_t m = d.len();
+  limb_t const *digits = d.data_.data();
+  shift_ = normalizing_shift(digits[m - 1]);
+  if (shift_ > 0) {
+    limbs::lshift(scaled_.data(), digits, m, shift_);
+  } else {
+    std::copy_n(digits, m, scaled_.data());
+  }
+  if (m == 1) {
+    inverse_ = inverse_2by1(scaled_[0]);
+    return;
+  }
+  inverse_ = inverse_3by2(scaled_[m - 1], scaled_[m - 2]);
+  if (m >= big_integer::div_newton_threshold) {
+    reciprocal_.resize(m + 1);
+    reciprocal(reciprocal_.data(), scaled_.data(), m, inverse_);
+  }
+}
+
+big_integer const &big_integer_divisor::value() const {
+  return value_;
+}
+
+// quot = *this / rhs rounded towards zero, rem = *this - quot * rhs;
+// quot and rem must be different objects, either of them may be *this or rhs;
+// prepared, if not null, holds the precomputed data of rhs
+void big_integer::divide(big_integer const &rhs, big_integer &quot, big_integer &rem,
+                         big_integer_divisor const *prepared) const {
+  error(rhs.is_zero(), "division by zero");
+  bool quot_negative = negative_ != rhs.negative_, rem_negative = negative_;
+  decltype(data_) q, r;
+  if (compare_magnitudes(rhs) == LESS) {
+    q.push_back(0);
+    r = data_;
+  } else {
+    q.resize(len() - rhs.len() + 1);
+    r.resize(rhs.len());
+    size_t n = len(), m = rhs.len();
+    if (prepared == nullptr) {
+      divmod_magnitudes(q.data(), r.data(), data_.data(), n, rhs.data_.data(), m);
+    } else if (m == 1) {
+      r[0] = div_1_preinv(q.data(), data_.data(), n, prepared->scaled_[0], prepared->shift_,
+                          prepared->inverse_);
+    } else {
+      bool newton = !prepared->reciprocal_.empty() && use_newton(n, m);
+      std::vector<limb_t> u(n + 1);
+      divmod_scaled(q.data(), r.data(), data_.data(), n, prepared->scaled_.data(), m,
+                    prepared->shift_, prepared->inverse_,
+                    newton ? prepared->reciprocal_.data() : nullptr, u.data());
     }
   }
+  quot.data_.swap(q);
+  quot.negative_ = quot_negative;
   quot.normalize();
-  quot.make_positive();
-  return *this = sign ? quot.negate() : quot;
+  rem.data_.swap(r);
+  rem.negative_ = rem_negative;
+  rem.normalize();
+}
+
+big_integer& big_integer::divmod(big_integer const &rhs, big_integer &rem)
+{
+  error(&rem == this, "divmod: the remainder must not be stored in the dividend");
+  divide(rhs, *this, rem);
+  return *this;
+}
+
+big_integer& big_integer::operator/=(big_integer const &rhs)
+{
+  big_integer rem;
+  return divmod(rhs, rem);
 }
 
 big_integer& big_integer::operator%=(big_integer const &rhs)
 {
-  error(rhs == 0, "division by zero");
-  big_integer temp(*this);
-  return *this -= (temp /= rhs) *= rhs;
+  // the same pass as divmod, with the roles of the outputs swapped
+  big_integer quot;
+  divide(rhs, quot, *this);
+  return *this;
+}
+
+big_integer& big_integer::divmod(big_integer_divisor const &rhs, big_integer &rem)
+{
+  error(&rem == this, "divmod: the remainder must not be stored in the dividend");
+  divide(rhs.value_, *this, rem, &rhs);
+  return *this;
+}
+
+big_integer& big_integer::operator/=(big_integer_divisor const &rhs)
+{
+  big_integer rem;
+  return divmod(rhs, rem);
+}
+
+big_integer& big_integer::operator%=(big_integer_divisor const &rhs)
+{
+  big_integer quot;
+  divide(rhs.value_, quot, *this, &rhs);
+  return *this;
 }
 
 // ***bitwise operations***
@@ -348,14 +1077,44 @@ namespace {
   const auto &bit_xor = std::bit_xor<limb_t>();
 }
 
+// n > len(), so the top bit of the result is the sign
+std::vector<limb_t> big_integer::to_twos_complement(size_t n) const {
+  std::vector<limb_t> res(n);
+  std::copy_n(data_.data(), len(), res.begin());
+  if (negative_) {
+    limbs::neg(res.data(), res.data(), n);
+  }
+  return res;
+}
+
+void big_integer::from_twos_complement(std::vector<limb_t> a) {
+  negative_ = most_significant_bit(a.back()) == 1;
+  if (negative_) {
+    limbs::neg(a.data(), a.data(), a.size());
+  }
+  new_buffer(a.size());
+  std::copy(a.begin(), a.end(), data_.data());
+  normalize();
+}
+
 big_integer& big_integer::bit_operation(
         big_integer const &rhs,
         const std::function<limb_t(limb_t, limb_t)> &f) {
-  new_buffer(std::max(len(), rhs.len()));
-  auto rbr = rhs.rest_bits();
-  for (size_t i = 0; i < len(); i++) {
-    data_[i] = f(data_[i], i < rhs.len() ? rhs.data_[i] : rbr);
+  size_t n = std::max(len(), rhs.len());
+  if (!negative_ && !rhs.negative_) {
+    // non-negative numbers are their own two's complement
+    new_buffer(n);
+    for (size_t i = 0; i < n; i++) {
+      data_[i] = f(data_[i], i < rhs.len() ? rhs.data_[i] : 0);
+    }
+    normalize();
+    return *this;
   }
+  auto a = to_twos_complement(n + 1), b = rhs.to_twos_complement(n + 1);
+  for (size_t i = 0; i <= n; i++) {
+    a[i] = f(a[i], b[i]);
+  }
+  from_twos_complement(std::move(a));
   return *this;
 }
 
@@ -379,89 +1138,87 @@ big_integer& big_integer::operator<<=(int rhs)
   if (rhs < 0) {
     return *this >>= -rhs;
   }
-  auto fill_value = rest_bits();
-  bool was_negative = is_negative();
   auto num = static_cast<size_t>(rhs);
-  auto rest = num % LIMB_T_BITS;
+  auto rest = static_cast<unsigned>(num % LIMB_T_BITS);
   num /= LIMB_T_BITS;
-  new_buffer(len() + num);
-  for (size_t i = len(); i --> 0 && num > 0;) {
-    data_[i] = i < num ? 0 : data_[i - num];
-  }
-  limb_t rem_bits = 0;
-  for (size_t i = num; i < len() && rest > 0; i++) {
-    auto new_rem_bits = rest == 0 ? 0 : data_[i] >> (LIMB_T_BITS - rest);
-    data_[i] = (data_[i] << rest) | rem_bits;
-    rem_bits = new_rem_bits;
-  }
-  if ((!was_negative && (is_negative() || rem_bits != 0))
-      || (was_negative && rem_bits != 0 && (!is_negative() || pow2(rest) != rem_bits + 1))) {
-    data_.push_back((fill_value << rest) | rem_bits);
+  size_t old_len = len();
+  // one more limb receives the bits shifted out of the top
+  new_buffer(old_len + num + 1);
+  limb_t *p = data_.data();
+  std::copy_backward(p, p + old_len, p + old_len + num);
+  std::fill_n(p, num, 0);
+  if (rest > 0) {
+    p[old_len + num] = limbs::lshift(p + num, p + num, old_len, rest);
   }
+  normalize();
   return *this;
 }
 
+// rounds towards minus infinity, like an arithmetic shift of the two's complement form:
+// the magnitude of a negative number is rounded up
 big_integer& big_integer::operator>>=(int rhs)
 {
   if (rhs < 0) {
     return *this <<= -rhs;
   }
-  auto num = std::min(static_cast<size_t>(rhs), LIMB_T_BITS * len());
-  auto rest = num % LIMB_T_BITS;
+  auto num = static_cast<size_t>(rhs);
+  auto rest = static_cast<unsigned>(num % LIMB_T_BITS);
   num /= LIMB_T_BITS;
-  auto fill_value = rest_bits();
-  for (size_t i = 0; i < len() && num > 0; i++) {
-    data_[i] = i < len() - num ? data_[i + num] : fill_value;
+  if (num >= len()) {
+    return *this = negative_ ? -1 : 0;
   }
-  limb_t rem_bits = rest == 0 ? 0 : fill_value << (LIMB_T_BITS - rest);
-  for (size_t i = len(); i --> 0 && rest > 0;) {
-    auto new_rem_bits = data_[i] << (LIMB_T_BITS - rest);
-    data_[i] = rem_bits | (data_[i] >> rest);
-    rem_bits = new_rem_bits;
+  limb_t *p = data_.data();
+  bool lost_bits = significant_len(p, num) > 0;
+  std::copy(p + num, p + len(), p);
+  new_buffer(len() - num);
+  if (rest > 0) {
+    lost_bits |= limbs::rshift(data_.data(), data_.data(), len(), rest) != 0;
   }
+  if (negative_ && lost_bits) {
+    limbs::add_1(data_.data(), data_.data(), len(), 1);
+  }
+  normalize();
   return *this;
 }
 
 // ***unary arithmetic operations***
 
-big_integer big_integer::operator+() const
+big_integer big_integer::operator+() const &
 {
   return *this;
 }
 
+big_integer big_integer::operator+() &&
+{
+  return std::move(*this);
+}
+
 big_integer& big_integer::negate() {
-  for (size_t i = 0; i < len(); i++) {
-    data_[i] = ~data_[i];
-  }
-  limb_t carry_bit = 1;
-  // *special case for 10...0*
-  limb_t check_mask = 0;
-  for (size_t i = 0; i < len() - 1; i++) {
-    check_mask |= data_[i];
-  }
-  if (~data_[len() - 1] == pow2(LIMB_T_BITS - 1) && check_mask == 0) {
-    new_buffer(len() + 1);
-    return ++*this;
-  }
-  // *end of check*
-  for (size_t i = 0; i < len() && carry_bit == 1; i++) {
-    auto new_carry = carry(data_[i], carry_bit);
-    data_[i]++;
-    carry_bit = new_carry;
-  }
+  negative_ = !negative_ && !is_zero();
   return *this;
 }
 
-big_integer big_integer::operator-() const
+big_integer big_integer::operator-() const &
 {
-  big_integer r(*this);
-  return r.negate();
+  return -big_integer(*this);
 }
 
-big_integer big_integer::operator~() const
+big_integer big_integer::operator-() &&
 {
-  big_integer r(*this);
-  return r.bit_operation(-1, bit_xor);
+  negate();
+  return std::move(*this);
+}
+
+// ~x = -x - 1
+big_integer big_integer::operator~() const &
+{
+  return ~big_integer(*this);
+}
+
+big_integer big_integer::operator~() &&
+{
+  negate() -= 1;
+  return std::move(*this);
 }
 
 big_integer& big_integer::operator++()
@@ -492,64 +1249,182 @@ big_integer big_integer::operator--(int)
 
 big_integer operator+(big_integer a, big_integer const &b)
 {
-  return a += b;
+  a += b;
+  return a;
 }
 
 big_integer operator-(big_integer a, big_integer const &b)
 {
-  return a -= b;
+  a -= b;
+  return a;
 }
 
 big_integer operator*(big_integer a, big_integer const &b)
 {
-  return a *= b;
+  a *= b;
+  return a;
 }
 
 big_integer operator/(big_integer a, big_integer const &b)
 {
-  return a /= b;
+  a /= b;
+  return a;
 }
 
 big_integer operator%(big_integer a, big_integer const &b)
 {
-  return a %= b;
+  a %= b;
+  return a;
+}
+
+std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b)
+{
+  std::pair<big_integer, big_integer> res;
+  a.divide(b, res.first, res.second);
+  return res;
+}
+
+big_integer operator/(big_integer a, big_integer_divisor const &b)
+{
+  a /= b;
+  return a;
+}
+
+big_integer operator%(big_integer a, big_integer_divisor const &b)
+{
+  a %= b;
+  return a;
+}
+
+std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer_divisor const &b)
+{
+  std::pair<big_integer, big_integer> res;
+  a.divide(b.value(), res.first, res.second, &b);
+  return res;
 }
 
 big_integer operator&(big_integer a, big_integer const &b)
 {
-  return a &= b;
+  a &= b;
+  return a;
 }
 
 big_integer operator|(big_integer a, big_integer const &b)
 {
-  return a |= b;
+  a |= b;
+  return a;
 }
 
 big_integer operator^(big_integer a, big_integer const &b)
 {
-  return a ^= b;
+  a ^= b;
+  return a;
+}
+
+namespace {
+  // whether x has room for the result of x op y for op in +, -, &, |, ^
+  bool has_room(big_integer const &x, big_integer const &y) {
+    return x.capacity() > std::max(x.limbs().size, y.limbs().size);
+  }
+
+  // a op b, computed in b if it has room; swapped says that b op a is -(a op b)
+  template <typename Assign>
+  big_integer in_place(big_integer const &a, big_integer &&b, Assign assign, bool swapped) {
+    if (!has_room(b, a)) {
+      big_integer r(a);
+      assign(r, b);
+      return r;
+    }
+    assign(b, a);
+    return swapped ? -std::move(b) : std::move(b);
+  }
+
+  template <typename Assign>
+  big_integer in_place(big_integer &&a, big_integer &&b, Assign assign, bool swapped) {
+    if (!has_room(a, b) && has_room(b, a)) {
+      return in_place(a, std::move(b), assign, swapped);
+    }
+    assign(a, b);
+    return std::move(a);
+  }
+
+  void add(big_integer &x, big_integer const &y) { x += y; }
+  void sub(big_integer &x, big_integer const &y) { x -= y; }
+  void and_to(big_integer &x, big_integer const &y) { x &= y; }
+  void or_to(big_integer &x, big_integer const &y) { x |= y; }
+  void xor_to(big_integer &x, big_integer const &y) { x ^= y; }
+}
+
+big_integer operator+(big_integer const &a, big_integer &&b)
+{
+  return in_place(a, std::move(b), add, false);
+}
+
+big_integer operator+(big_integer &&a, big_integer &&b)
+{
+  return in_place(std::move(a), std::move(b), add, false);
+}
+
+big_integer operator-(big_integer const &a, big_integer &&b)
+{
+  return in_place(a, std::move(b), sub, true);
+}
+
+big_integer operator-(big_integer &&a, big_integer &&b)
+{
+  return in_place(std::move(a), std::move(b), sub, true);
+}
+
+big_integer operator&(big_integer const &a, big_integer &&b)
+{
+  return in_place(a, std::move(b), and_to, false);
+}
+
+big_integer operator&(big_integer &&a, big_integer &&b)
+{
+  return in_place(std::move(a), std::move(b), and_to, false);
+}
+
+big_integer operator|(big_integer const &a, big_integer &&b)
+{
+  return in_place(a, std::move(b), or_to, false);
+}
+
+big_integer operator|(big_integer &&a, big_integer &&b)
+{
+  return in_place(std::move(a), std::move(b), or_to, false);
+}
+
+big_integer operator^(big_integer const &a, big_integer &&b)
+{
+  return in_place(a, std::move(b), xor_to, false);
+}
+
+big_integer operator^(big_integer &&a, big_integer &&b)
+{
+  return in_place(std::move(a), std::move(b), xor_to, false);
 }
 
 big_integer operator<<(big_integer a, int b)
 {
-  return a <<= b;
+  a <<= b;
+  return a;
 }
 
 big_integer operator>>(big_integer a, int b)
 {
-  return a >>= b;
+  a >>= b;
+  return a;
 }
 
 // ***comparison***
 
 int big_integer::compare_numerically(big_integer const &rhs) const {
-  bool neg1 = is_negative(), neg2 = rhs.is_negative();
-  if (neg1 && !neg2) {
-    return LESS;
-  } else if (!neg1 && neg2) {
-    return GREATER;
+  if (negative_ != rhs.negative_) {
+    return negative_ ? LESS : GREATER;
   }
-  return compare_lexicographically(rhs, neg1 ? LIMB_T_MAX : 0);
+  int cmp = compare_magnitudes(rhs);
+  return negative_ ? -cmp : cmp;
 }
 
 bool operator==(big_integer const &a, big_integer const &b)
@@ -582,44 +1457,552 @@ bool operator>=(big_integer const &a, big_integer const &b)
   return !(a < b);
 }
 
-// ***to_string and related functions***
+// ***binary import and export***
 
-limb_t big_integer::div_short(limb_t divisor) {
-  limb_t carry = 0;
-  for (size_t i = len(); i --> 0;) {
-    dlimb_t t = glue(carry, 0) + data_[i];
-    data_[i] = t / divisor;
-    carry = t % divisor;
+namespace {
+  bool host_little_endian() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return false;
+#else
+    return true;
+#endif
+  }
+
+  // the words hold the bytes of the number least significant first and so do the limbs
+  bool plain_layout(word_order order, byte_order endian) {
+    bool little = endian == byte_order::little
+                  || (endian == byte_order::native && host_little_endian());
+    return order == word_order::least_significant_first && little && host_little_endian();
+  }
+
+  // byte k of the limbs, counted from the least significant one
+  unsigned char limb_byte(big_integer::limb_span v, size_t k) {
+    return static_cast<unsigned char>(v[k / sizeof(limb_t)] >> (8 * (k % sizeof(limb_t))));
+  }
+
+  // the offset in the output of byte j (counted from the least significant one) of word w
+  size_t byte_offset(size_t w, size_t j, size_t count, size_t word_size,
+                     word_order order, byte_order endian) {
+    bool big = endian == byte_order::big || (endian == byte_order::native && !host_little_endian());
+    size_t word = order == word_order::most_significant_first ? count - 1 - w : w;
+    return word * word_size + (big ? word_size - 1 - j : j);
   }
-  normalize();
-  make_positive();
-  return carry;
 }
 
-std::string to_string(big_integer const &a)
+big_integer::limb_span big_integer::limbs() const {
+  return {data_.data(), len()};
+}
+
+size_t big_integer::capacity() const {
+  return data_.capacity();
+}
+
+size_t export_size(big_integer const &a, size_t word_size)
+{
+  big_integer::limb_span v = a.limbs();
+  size_t bytes = v.size * sizeof(limb_t);
+  while (bytes > 0 && limb_byte(v, bytes - 1) == 0) {
+    bytes--;
+  }
+  return (bytes + word_size - 1) / word_size;
+}
+
+size_t export_bytes(void *out, big_integer const &a, size_t word_size,
+                    word_order order, byte_order endian)
+{
+  big_integer::limb_span v = a.limbs();
+  size_t count = export_size(a, word_size), bytes = count * word_size;
+  size_t limb_bytes = std::min(bytes, v.size * sizeof(limb_t));
+  unsigned char *res = static_cast<unsigned char *>(out);
+  if (plain_layout(order, endian)) {
+    std::memcpy(res, v.data, limb_bytes);
+    std::fill(res + limb_bytes, res + bytes, 0);
+    return count;
+  }
+  for (size_t k = 0; k < bytes; k++) {
+    res[byte_offset(k / word_size, k % word_size, count, word_size, order, endian)] =
+        k < limb_bytes ? limb_byte(v, k) : 0;
+  }
+  return count;
+}
+
+big_integer import_bytes(void const *in, size_t count, size_t word_size,
+                         word_order order, byte_order endian)
 {
-  if (a == 0) {
-    return "0";
+  big_integer res;
+  size_t bytes = count * word_size;
+  res.new_buffer(std::max((bytes + sizeof(limb_t) - 1) / sizeof(limb_t), static_cast<size_t>(1)));
+  limb_t *p = res.data_.data();
+  std::fill_n(p, res.len(), 0);
+  unsigned char const *src = static_cast<unsigned char const *>(in);
+  if (plain_layout(order, endian)) {
+    std::memcpy(p, src, bytes);
+  } else {
+    for (size_t k = 0; k < bytes; k++) {
+      limb_t byte = src[byte_offset(k / word_size, k % word_size, count, word_size, order, endian)];
+      p[k / sizeof(limb_t)] |= byte << (8 * (k % sizeof(limb_t)));
+    }
+  }
+  res.normalize();
+  return res;
+}
+
+// ***to_string and related functions***
+
+namespace {
+  // p[pos / B, ...) |= value << (pos % B), for a value of at most nbits < B bits
+  void or_bits(limb_t *p, size_t pos, limb_t value, size_t nbits) {
+    size_t i = pos / LIMB_T_BITS, shift = pos % LIMB_T_BITS;
+    p[i] |= value << shift;
+    if (shift + nbits > LIMB_T_BITS) {
+      p[i + 1] |= value >> (LIMB_T_BITS - shift);
+    }
+  }
+
+  // p[0, m) = p[0, m) * chunk_base + chunk, returns the new length; the caller makes sure the
+  // result fits in the buffer
+  size_t mul_add_chunk(limb_t *p, size_t m, limb_t chunk_base, limb_t chunk) {
+    limb_t carry = limbs::mul_1(p, p, m, chunk_base);
+    carry += limbs::add_1(p, p, m, chunk);
+    if (carry != 0) {
+      p[m++] = carry;
+    }
+    return m;
+  }
+}
+
+// *this = the number written in the power-of-two base digits [first, last), which are
+// packed into the limbs from the last one; returns false if one is not a digit
+bool big_integer::parse_pow2(char const *first, char const *last, radix const &r) {
+  size_t n = last - first;
+  new_buffer((n * r.bits + LIMB_T_BITS - 1) / LIMB_T_BITS + 1);
+  std::fill_n(data_.data(), len(), 0);
+  limb_t *p = data_.data();
+  size_t pos = 0;
+  while (last != first) {
+    limb_t digit = digits::digit_value(*--last);
+    if (digit >= r.base) {
+      return false;
+    }
+    or_bits(p, pos, digit, r.bits);
+    pos += r.bits;
+  }
+  return true;
+}
+
+// *this = the number written in the digits [first, last), by chunks of chunk_len digits;
+// the buffer is allocated once, for the most limbs the digits can take;
+// returns false if one of the characters is not a digit
+bool big_integer::parse_digits(char const *first, char const *last, radix const &r) {
+  size_t n = last - first, head = (n - 1) % r.chunk_len + 1;
+  new_buffer((n - 1) / r.chunk_len + 1);
+  limb_t *p = data_.data();
+  if (!digits::parse_chunk(first, head, r.base, p[0])) {
+    return false;
+  }
+  size_t m = 1;
+  for (first += head; first != last; first += r.chunk_len) {
+    limb_t chunk;
+    if (!digits::parse_chunk(first, r.chunk_len, r.base, chunk)) {
+      return false;
+    }
+    // the value times chunk_base plus a chunk is below chunk_base^chunks <= B^chunks,
+    // so the buffer is long enough
+    m = mul_add_chunk(p, m, r.chunk_base, chunk);
+  }
+  new_buffer(m);
+  return true;
+}
+
+// powers[i] = chunk_base^(2^i); the digits are split so that the low part has as many digits
+// as the largest power below their number, and the parts are parsed recursively
+bool big_integer::parse_digits(char const *first, char const *last, radix const &r,
+                               std::vector<big_integer> const &powers) {
+  size_t n = last - first;
+  if (n < FROM_STRING_THRESHOLD * r.chunk_len) {
+    return parse_digits(first, last, r);
+  }
+  size_t i = 0;
+  while (i + 1 < powers.size() && (r.chunk_len << (i + 1)) < n) {
+    i++;
+  }
+  char const *mid = last - (r.chunk_len << i);
+  big_integer low;
+  if (!parse_digits(first, mid, r, powers) || !low.parse_digits(mid, last, r, powers)) {
+    return false;
+  }
+  *this *= powers[i];
+  *this += low;
+  return true;
+}
+
+// *this = the number with the digits c[0, n) in base chunk_base, most significant first;
+// powers[i] = chunk_base^(2^i), the chunks are split as the digits of a string are
+void big_integer::from_chunks(limb_t const *c, size_t n, radix const &r,
+                              std::vector<big_integer> const &powers) {
+  if (n < FROM_STRING_THRESHOLD) {
+    new_buffer(std::max(n, static_cast<size_t>(1)));
+    limb_t *p = data_.data();
+    p[0] = n > 0 ? c[0] : 0;
+    size_t m = 1;
+    for (size_t i = 1; i < n; i++) {
+      m = mul_add_chunk(p, m, r.chunk_base, c[i]);
+    }
+    new_buffer(m);
+    negative_ = false;
+    return;
   }
-  std::string res;
-  auto temp(a);
-  temp.make_abs();
-  while (temp != 0) {
-    auto digit = temp.div_short(MOD);
-    auto digit_str = std::to_string(digit);
-    res.append(digit_str.rbegin(), digit_str.rend());
-    if (temp != 0) {
-      res.append(DECIMAL_DIGIT_LEN - digit_str.size(), '0');
+  size_t i = 0;
+  while (i + 1 < powers.size() && (size_t(1) << (i + 1)) < n) {
+    i++;
+  }
+  size_t low_len = size_t(1) << i;
+  big_integer low;
+  from_chunks(c, n - low_len, r, powers);
+  low.from_chunks(c + n - low_len, low_len, r, powers);
+  *this *= powers[i];
+  *this += low;
+}
+
+namespace {
+  // below this length (in limbs) a number is converted by repeated short division
+  const size_t TO_STRING_THRESHOLD = 40;
+  // the block in which operator<< collects characters before writing them to the stream
+  const size_t STREAM_BLOCK_SIZE = 1 << 16;
+}
+
+// the characters of a number go to the buffer [begin, end); with a stream, the buffer is
+// written out whenever it fills up, otherwise it must be long enough for all of them
+struct big_integer::digit_sink {
+  char *begin, *pos, *end;
+  std::ostream *stream;
+  bool uppercase;
+
+  // room for n characters at pos, n <= end - begin
+  char *reserve(size_t n) {
+    if (static_cast<size_t>(end - pos) < n) {
+      flush();
+    }
+    assert(static_cast<size_t>(end - pos) >= n);
+    return pos;
+  }
+
+  void put(char const *s, size_t n) {
+    pos = std::copy_n(s, n, reserve(n));
+  }
+
+  void fill_zeros(size_t n) {
+    while (n > 0) {
+      size_t k = std::min(n, static_cast<size_t>(end - begin));
+      pos = std::fill_n(reserve(k), k, '0');
+      n -= k;
+    }
+  }
+
+  void flush() {
+    if (stream == nullptr) {
+      return;
     }
+    if (uppercase) {
+      for (char *c = begin; c != pos; ++c) {
+        *c = static_cast<char>(std::toupper(static_cast<unsigned char>(*c)));
+      }
+    }
+    stream->write(begin, pos - begin);
+    pos = begin;
+  }
+};
+
+// writes the power-of-two base digits of |*this| > 0; each digit is taken from the one or two
+// limbs its bits are in
+void big_integer::write_pow2(digit_sink &sink, radix const &r) const {
+  // the digits are written in pieces that fit in any sink buffer
+  const size_t PIECE = 1024;
+  limb_t const *p = data_.data();
+  size_t n = len(), top_bits = LIMB_T_BITS;
+  while ((p[n - 1] >> (top_bits - 1)) == 0) {
+    top_bits--;
+  }
+  size_t k = ((n - 1) * LIMB_T_BITS + top_bits + r.bits - 1) / r.bits;
+  while (k > 0) {
+    size_t piece = std::min(k, PIECE);
+    char *out = sink.reserve(piece);
+    for (size_t end = k - piece; k > end; ) {
+      size_t pos = --k * r.bits, i = pos / LIMB_T_BITS, shift = pos % LIMB_T_BITS;
+      limb_t digit = p[i] >> shift;
+      if (shift + r.bits > LIMB_T_BITS && i + 1 < n) {
+        digit |= p[i + 1] << (LIMB_T_BITS - shift);
+      }
+      *out++ = digits::digit_char(digit & (r.base - 1));
+    }
+    sink.pos = out;
+  }
+}
+
+// writes the digits of |*this| < B^TO_STRING_THRESHOLD, with leading zeros up to width
+// characters; the chunks are found in local buffers, the first one is written without
+// padding and the others with chunk_len digits each
+void big_integer::write_digits(digit_sink &sink, size_t width, radix const &r) const {
+  assert(len() < TO_STRING_THRESHOLD);
+  // chunk_base > B / base >= B^(1/2), so there are at most two chunks per limb
+  limb_t q[TO_STRING_THRESHOLD], chunks[2 * TO_STRING_THRESHOLD];
+  size_t n = significant_len(data_.data(), len()), count = 0;
+  std::copy_n(data_.data(), n, q);
+  while (n > 0) {
+    chunks[count++] = div_1(q, q, n, r.chunk_base);
+    n = significant_len(q, n);
+  }
+  size_t head = count == 0 ? 0 : digits::chunk_length(chunks[count - 1], r.base);
+  size_t length = count == 0 ? 0 : head + (count - 1) * r.chunk_len;
+  if (length < width) {
+    sink.fill_zeros(width - length);
+  }
+  char *out = sink.reserve(length);
+  if (count > 0) {
+    digits::format_chunk(out, chunks[--count], head, r.base);
+    out += head;
+  }
+  while (count > 0) {
+    digits::format_chunk(out, chunks[--count], r.chunk_len, r.base);
+    out += r.chunk_len;
+  }
+  sink.pos = out;
+}
+
+// powers[i] = chunk_base^(2^i); |*this| is split by the largest power of at most half its
+// length, and both parts are converted recursively, the low one padded to the number of
+// digits of the power
+void big_integer::write_digits(digit_sink &sink, size_t width, radix const &r,
+                               std::vector<big_integer_divisor> const &powers) const {
+  if (len() < TO_STRING_THRESHOLD) {
+    write_digits(sink, width, r);
+    return;
+  }
+  // powers[0] has a single limb, so some power fits
+  size_t i = powers.size();
+  while (2 * powers[i - 1].value_.len() > len() + 1) {
+    i--;
+  }
+  i--;
+  size_t low_width = r.chunk_len << i;
+  big_integer quot, rem;
+  divide(powers[i].value_, quot, rem, &powers[i]);
+  quot.write_digits(sink, width > low_width ? width - low_width : 0, r, powers);
+  rem.write_digits(sink, low_width, r, powers);
+}
+
+// writes the sign, then prefix (unless *this is zero), then the digits
+void big_integer::write_number(digit_sink &sink, radix const &r, char const *prefix) const {
+  if (is_zero()) {
+    sink.put("0", 1);
+    return;
+  }
+  if (is_negative()) {
+    sink.put("-", 1);
+  }
+  sink.put(prefix, std::strlen(prefix));
+  if (r.bits != 0) {
+    write_pow2(sink, r);
+    return;
   }
-  if (a.is_negative()) {
-    res.push_back('-');
+  if (len() < TO_STRING_THRESHOLD) {
+    write_digits(sink, 0, r);
+    return;
+  }
+  write_digits(sink, 0, r, chunk_powers(r, len()));
+}
+
+// chunk_base^(2^i), squared until they pass half the length of a number of n limbs; they are
+// kept for later calls, one table per base that only grows, so converting many numbers pays
+// for the powers and their reciprocals once. The tables are per thread, as copies share
+// buffers that the copy-on-write storage does not count atomically.
+std::vector<big_integer_divisor> const &big_integer::chunk_powers(radix const &r, size_t n)
+{
+  thread_local std::vector<big_integer_divisor> tables[37];
+  std::vector<big_integer_divisor> &powers = tables[r.base];
+  if (powers.empty()) {
+    powers.emplace_back(big_integer(&r.chunk_base, 1));
+  }
+  while (4 * powers.back().value_.len() <= n + 1) {
+    powers.emplace_back(powers.back().value_ * powers.back().value_);
+  }
+  return powers;
+}
+
+char *to_chars(char *first, char *last, big_integer const &a, int base)
+{
+  error(base < 2 || base > 36, "to_chars: the base must be in [2, 36]");
+  big_integer::radix r(base);
+  size_t bound = r.length_bound(a.len());
+  if (static_cast<size_t>(last - first) < bound) {
+    // the bound may be a few characters too many, so the number is written elsewhere first
+    char short_buffer[TO_STRING_THRESHOLD * LIMB_T_BITS + 1];
+    std::string long_buffer;
+    char *begin = short_buffer, *end;
+    if (a.len() < TO_STRING_THRESHOLD) {
+      end = to_chars(short_buffer, short_buffer + sizeof(short_buffer), a, base);
+    } else {
+      long_buffer = to_string(a, base);
+      begin = &long_buffer[0];
+      end = begin + long_buffer.size();
+    }
+    if (end - begin > last - first) {
+      return nullptr;
+    }
+    return std::copy(begin, end, first);
   }
-  std::reverse(res.begin(), res.end());
+  big_integer::digit_sink sink{first, first, last, nullptr, false};
+  a.write_number(sink, r, "");
+  return sink.pos;
+}
+
+size_t to_chars_size(big_integer const &a, int base)
+{
+  error(base < 2 || base > 36, "to_chars_size: the base must be in [2, 36]");
+  return big_integer::radix(base).length_bound(a.len());
+}
+
+char *to_chars(char *first, char *last, big_integer const &a)
+{
+  return to_chars(first, last, a, 10);
+}
+
+std::string to_string(big_integer const &a, int base)
+{
+  error(base < 2 || base > 36, "to_string: the base must be in [2, 36]");
+  // a single buffer, trimmed to the characters written
+  std::string res(big_integer::radix(base).length_bound(a.len()), '\0');
+  res.resize(to_chars(&res[0], &res[0] + res.size(), a, base) - &res[0]);
   return res;
 }
 
+std::string to_string(big_integer const &a)
+{
+  return to_string(a, 10);
+}
+
+namespace {
+  int stream_base(std::ios_base const &s) {
+    std::ios_base::fmtflags basefield = s.flags() & std::ios_base::basefield;
+    return basefield == std::ios_base::hex ? 16 : basefield == std::ios_base::oct ? 8 : 10;
+  }
+}
+
+// std::hex and std::oct select the base; std::showbase and std::uppercase work as they
+// do for the built-in types, with the prefix after the sign. The characters are written in
+// blocks as they are produced, unless a field width is set, which needs the whole string.
 std::ostream& operator<<(std::ostream &s, big_integer const &a)
 {
-  return s << to_string(a);
+  int base = stream_base(s);
+  std::ios_base::fmtflags flags = s.flags();
+  char const *prefix = base == 10 || !(flags & std::ios_base::showbase) ? ""
+                       : base == 16 ? "0x" : "0";
+  bool uppercase = (flags & std::ios_base::uppercase) && base != 10;
+  big_integer::radix r(base);
+  if (s.width() != 0) {
+    std::string res(r.length_bound(a.len()) + 2, '\0');
+    big_integer::digit_sink sink{&res[0], &res[0], &res[0] + res.size(), nullptr, false};
+    a.write_number(sink, r, prefix);
+    res.resize(sink.pos - &res[0]);
+    if (uppercase) {
+      for (char &c : res) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+      }
+    }
+    return s << res;
+  }
+  std::vector<char> block(STREAM_BLOCK_SIZE);
+  big_integer::digit_sink sink{block.data(), block.data(), block.data() + block.size(), &s,
+                               uppercase};
+  a.write_number(sink, r, prefix);
+  sink.flush();
+  return s;
+}
+
+// reads an optional sign and the longest run of digits in the base of std::hex, std::oct or
+// std::dec from the stream buffer, keeping them as limb-sized chunks; sets failbit and leaves
+// a unchanged if there are no digits. As for the built-in types, std::hex takes an optional
+// 0x or 0X after the sign, and the leading 0 of std::oct is read as a digit
+std::istream& operator>>(std::istream &s, big_integer &a)
+{
+  std::istream::sentry sentry(s);
+  if (!sentry) {
+    return s;
+  }
+  typedef std::char_traits<char> traits;
+  big_integer::radix r(stream_base(s));
+  std::streambuf *buf = s.rdbuf();
+  traits::int_type c = buf->sgetc();
+  bool negative = false;
+  if (c == traits::to_int_type('-') || c == traits::to_int_type('+')) {
+    negative = c == traits::to_int_type('-');
+    c = buf->snextc();
+  }
+  std::vector<limb_t> chunks;
+  limb_t tail = 0;
+  size_t tail_len = 0, count = 0;
+  if (r.base == 16 && traits::eq_int_type(c, traits::to_int_type('0'))) {
+    // an optional 0x or 0X, which has to be followed by digits; a 0 without it is a digit
+    c = buf->snextc();
+    if (traits::eq_int_type(c, traits::to_int_type('x')) ||
+        traits::eq_int_type(c, traits::to_int_type('X'))) {
+      c = buf->snextc();
+    } else {
+      count = 1;
+    }
+  }
+  for (; !traits::eq_int_type(c, traits::eof()); c = buf->snextc()) {
+    limb_t digit = digits::digit_value(traits::to_char_type(c));
+    if (digit >= r.base) {
+      break;
+    }
+    tail = tail * r.base + digit;
+    count++;
+    if (++tail_len == r.chunk_len) {
+      chunks.push_back(tail);
+      tail = 0;
+      tail_len = 0;
+    }
+  }
+  std::ios_base::iostate state = std::ios_base::goodbit;
+  if (traits::eq_int_type(c, traits::eof())) {
+    state |= std::ios_base::eofbit;
+  }
+  if (count == 0) {
+    s.setstate(state | std::ios_base::failbit);
+    return s;
+  }
+  big_integer res;
+  if (r.bits != 0) {
+    // chunk_len digits of bits bits each, packed from the tail
+    size_t chunk_bits = r.chunk_len * r.bits, pos = tail_len * r.bits;
+    res.new_buffer((pos + chunks.size() * chunk_bits) / LIMB_T_BITS + 2);
+    limb_t *p = res.data_.data();
+    std::fill_n(p, res.len(), 0);
+    or_bits(p, 0, tail, pos);
+    for (size_t i = chunks.size(); i-- > 0; pos += chunk_bits) {
+      or_bits(p, pos, chunks[i], chunk_bits);
+    }
+  } else {
+    std::vector<big_integer> powers;
+    big_integer power(&r.chunk_base, 1);
+    powers.push_back(power);
+    while ((size_t(1) << powers.size()) < chunks.size()) {
+      power *= power;
+      powers.push_back(power);
+    }
+    res.from_chunks(chunks.data(), chunks.size(), r, powers);
+    limb_t scale = 1;
+    for (size_t i = 0; i < tail_len; i++) {
+      scale *= r.base;
+    }
+    size_t n = res.len();
+    res.new_buffer(n + 1);
+    res.new_buffer(mul_add_chunk(res.data_.data(), n, scale, tail));
+  }
+  res.negative_ = negative;
+  res.normalize();
+  a = std::move(res);
+  s.setstate(state);
+  return s;
 }
@@ -0,0 +1,108 @@
+#include "big_integer_barrett.h"
+#include "big_integer_kernels.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+  using limb_t = big_integer::limb_t;
+  const size_t LIMB_T_BITS = std::numeric_limits<limb_t>::digits;
+
+  // up to this modulus length (in limbs) the two products are computed by halves in the
+  // basecase; longer moduli use full big_integer products, which switch to Karatsuba and beyond
+  const size_t BARRETT_SHORT_THRESHOLD = 48;
+
+  // r[0, k) = a[0, n) mod m[0, k), k <= n <= 2k, mu[0, mu_len) = B^2k / m
+  void reduce_basecase(limb_t *r, limb_t const *a, size_t n, limb_t const *m, size_t k,
+                       limb_t const *mu, size_t mu_len) {
+    // q = (a / B^(k - 1)) * mu / B^(k + 1): the partial products below limb k - 1 are
+    // skipped, they add less than 1 to the quotient, which is then at most 3 too small
+    limb_t const *q1 = a + k - 1;
+    size_t q1_len = n - k + 1;
+    std::vector<limb_t> t(q1_len + mu_len + k + 1);
+    limb_t *p = t.data(), *s = p + q1_len + mu_len;
+    for (size_t j = 0; j < q1_len; j++) {
+      size_t from = j < k - 1 ? k - 1 - j : 0;
+      if (from < mu_len) {
+        p[j + mu_len] = limbs::addmul_1(p + j + from, mu + from, mu_len - from, q1[j]);
+      }
+    }
+    limb_t const *q = p + k + 1;
+    size_t q_len = q1_len + mu_len - (k + 1);
+
+    // s = q * m mod B^(k + 1), only the low k + 1 limbs are needed
+    std::fill_n(s, k + 1, 0);
+    for (size_t j = 0; j < std::min(q_len, k + 1); j++) {
+      size_t len = std::min(k, k + 1 - j);
+      limb_t carry = limbs::addmul_1(s + j, m, len, q[j]);
+      if (j + len < k + 1) {
+        s[j + len] += carry;
+      }
+    }
+
+    // the true remainder is a - q * m < 4m < B^(k + 1), so it is exact modulo B^(k + 1)
+    std::copy_n(a, std::min(n, k + 1), p);
+    std::fill(p + std::min(n, k + 1), p + k + 1, 0);
+    limbs::sub_n(p, p, s, k + 1);
+    while (p[k] != 0 || limbs::cmp(p, m, k) >= 0) {
+      p[k] -= limbs::sub_n(p, p, m, k);
+    }
+    std::copy_n(p, k, r);
+  }
+}
+
+big_integer_barrett::big_integer_barrett(big_integer const &mod)
+    : modulus_(mod.is_negative() ? -mod : mod), k_(mod.len())
+{
+  if (mod.is_zero()) {
+    throw std::runtime_error("barrett: zero modulus");
+  }
+  mu_ = (big_integer(1) << static_cast<int>(2 * k_ * LIMB_T_BITS)) / modulus_;
+}
+
+big_integer const &big_integer_barrett::modulus() const {
+  return modulus_;
+}
+
+big_integer big_integer_barrett::reduce(big_integer const &x) const {
+  size_t n = x.len();
+  big_integer r;
+  if (n > 2 * k_) {
+    r = x % modulus_;
+    r.negative_ = false;
+  } else if (n < k_) {
+    // |x| < B^(k - 1) <= N
+    r = x;
+    r.negative_ = false;
+  } else if (k_ < BARRETT_SHORT_THRESHOLD) {
+    r.data_.resize(k_);
+    reduce_basecase(r.data_.data(), x.data_.data(), n, modulus_.data_.data(), k_,
+                    mu_.data_.data(), mu_.len());
+    r.normalize();
+  } else {
+    r = x.is_negative() ? -x : x;
+    big_integer q = ((r >> static_cast<int>((k_ - 1) * LIMB_T_BITS)) * mu_)
+                    >> static_cast<int>((k_ + 1) * LIMB_T_BITS);
+    r -= q * modulus_;
+    while (r >= modulus_) {
+      r -= modulus_;
+    }
+  }
+  // r = |x| mod N
+  if (x.is_negative() && !r.is_zero()) {
+    r = modulus_ - r;
+  }
+  return r;
+}
+
+big_integer big_integer_barrett::mulmod(big_integer const &a, big_integer const &b) const {
+  return reduce(a * b);
+}
+
+big_integer big_integer_barrett::sqrmod(big_integer const &a) const {
+  big_integer t = a;
+  t *= t;
+  return reduce(t);
+}
@@ -0,0 +1,228 @@
+#include "big_integer_digits.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BIG_INTEGER_X86_64_DIGITS
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+  const uint64_t ONES = 0x0101010101010101;
+
+  char const DIGIT_PAIRS[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+
+  char const DIGIT_CHARS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+  // out[0, n) = the n low decimal digits of value, with leading zeros
+  void format_32(char *out, uint32_t value, size_t n) {
+    for (; n >= 2; n -= 2) {
+      std::memcpy(out + n - 2, DIGIT_PAIRS + 2 * (value % 100), 2);
+      value /= 100;
+    }
+    if (n == 1) {
+      out[0] = static_cast<char>('0' + value % 10);
+    }
+  }
+
+  uint64_t load_8(char const *s) {
+    uint64_t res;
+    std::memcpy(&res, s, sizeof(res));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    res = __builtin_bswap64(res);
+#endif
+    return res;
+  }
+
+  // ***portable digits***
+  // The first digit is the lowest byte of the word. A byte is a digit if its high half is 3
+  // both as is and after adding 6, and the three multiplications combine neighbouring digits,
+  // then pairs, then fours.
+
+  bool parse_8(char const *s, uint64_t &value) {
+    uint64_t v = load_8(s);
+    if ((v & (0xF0 * ONES)) != 0x30 * ONES || ((v + 0x06 * ONES) & (0xF0 * ONES)) != 0x30 * ONES) {
+      return false;
+    }
+    v -= 0x30 * ONES;
+    v = v * 10 + (v >> 8);
+    v = ((v & 0x000000FF000000FF) * (100 + (1000000ull << 32))
+         + ((v >> 16) & 0x000000FF000000FF) * (1 + (10000ull << 32))) >> 32;
+    value = v;
+    return true;
+  }
+
+  bool portable_parse_16(char const *s, uint64_t &value) {
+    uint64_t hi, lo;
+    if (!parse_8(s, hi) || !parse_8(s + 8, lo)) {
+      return false;
+    }
+    value = hi * 100000000 + lo;
+    return true;
+  }
+
+  // ***SSE4.1 digits***
+  // pmaddubsw, pmaddwd and a second pmaddwd after packusdw combine the digits into pairs,
+  // fours and eights; a byte is a digit if it is at most 9 after subtracting '0'
+
+#ifdef BIG_INTEGER_X86_64_DIGITS
+  __attribute__((target("sse4.1")))
+  bool sse41_parse_16(char const *s, uint64_t &value) {
+    __m128i d = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(s)),
+                             _mm_set1_epi8('0'));
+    __m128i nine = _mm_set1_epi8(9);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(d, nine), nine)) != 0xFFFF) {
+      return false;
+    }
+    __m128i pairs = _mm_maddubs_epi16(d, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1,
+                                                        10, 1, 10, 1, 10, 1, 10, 1));
+    __m128i fours = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    __m128i eights = _mm_madd_epi16(_mm_packus_epi32(fours, fours),
+                                    _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+    value = static_cast<uint64_t>(static_cast<uint32_t>(_mm_cvtsi128_si32(eights))) * 100000000
+            + static_cast<uint32_t>(_mm_extract_epi32(eights, 1));
+    return true;
+  }
+
+  bool cpu_has_sse41() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+      return false;
+    }
+    return (ecx & bit_SSSE3) && (ecx & bit_SSE4_1);
+  }
+#endif
+
+  // ***dispatch***
+
+  // constant-initialized, so strings can be parsed during static initialization
+  // of other translation units, before the startup selection below has run
+  bool (*parse_16)(char const *, uint64_t &) = portable_parse_16;
+
+  bool select_parse_16() {
+#ifdef BIG_INTEGER_X86_64_DIGITS
+    char const *forced = std::getenv("BIG_INTEGER_KERNELS");
+    if ((forced == nullptr || std::strcmp(forced, "portable") != 0) && cpu_has_sse41()) {
+      parse_16 = sse41_parse_16;
+    }
+#endif
+    return true;
+  }
+
+  const bool STARTUP_SELECTED = select_parse_16();
+}
+
+namespace digits {
+  bool parse_chunk(char const *s, size_t n, limb_t &value) {
+    uint64_t res = 0, part;
+    if (n >= 16) {
+      if (!parse_16(s, part)) {
+        return false;
+      }
+      res = part;
+      s += 16;
+      n -= 16;
+    }
+    if (n >= 8) {
+      if (!parse_8(s, part)) {
+        return false;
+      }
+      res = res * 100000000 + part;
+      s += 8;
+      n -= 8;
+    }
+    for (; n > 0; s++, n--) {
+      unsigned digit = static_cast<unsigned char>(*s) - static_cast<unsigned>('0');
+      if (digit > 9) {
+        return false;
+      }
+      res = res * 10 + digit;
+    }
+    value = static_cast<limb_t>(res);
+    return true;
+  }
+
+  size_t chunk_length(limb_t value) {
+    size_t res = 0;
+    for (; value >= 100; value /= 100) {
+      res += 2;
+    }
+    return res + (value >= 10 ? 2 : value > 0 ? 1 : 0);
+  }
+
+  void format_chunk(char *out, limb_t value, size_t n) {
+    // 64-bit values are cut into 32-bit parts of eight digits, which divide faster
+    uint64_t v = value;
+    while (n > 8 && v >= (1ull << 32)) {
+      format_32(out + n - 8, static_cast<uint32_t>(v % 100000000), 8);
+      v /= 100000000;
+      n -= 8;
+    }
+    if (v >= (1ull << 32)) {
+      // n <= 8 digits are left, which the low eight digits of v hold
+      v %= 100000000;
+    }
+    format_32(out, static_cast<uint32_t>(v), n);
+  }
+
+  bool parse_chunk(char const *s, size_t n, unsigned base, limb_t &value) {
+    if (base == 10) {
+      return parse_chunk(s, n, value);
+    }
+    limb_t res = 0;
+    for (; n > 0; s++, n--) {
+      unsigned digit = digit_value(*s);
+      if (digit >= base) {
+        return false;
+      }
+      res = res * base + digit;
+    }
+    value = res;
+    return true;
+  }
+
+  size_t chunk_length(limb_t value, unsigned base) {
+    if (base == 10) {
+      return chunk_length(value);
+    }
+    size_t res = 0;
+    for (; value > 0; value /= base) {
+      res++;
+    }
+    return res;
+  }
+
+  void format_chunk(char *out, limb_t value, size_t n, unsigned base) {
+    if (base == 10) {
+      format_chunk(out, value, n);
+      return;
+    }
+    while (n-- > 0) {
+      out[n] = DIGIT_CHARS[value % base];
+      value /= base;
+    }
+  }
+
+  unsigned digit_value(char c) {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    if (c >= 'a' && c <= 'z') {
+      return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'Z') {
+      return c - 'A' + 10;
+    }
+    return 36;
+  }
+
+  char digit_char(unsigned d) {
+    return DIGIT_CHARS[d];
+  }
+}
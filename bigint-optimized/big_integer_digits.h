@@ -0,0 +1,38 @@
+#ifndef BIG_INTEGER_DIGITS_H
+#define BIG_INTEGER_DIGITS_H
+
+#include <cstddef>
+#include "big_integer.h"
+
+// ***conversion between ASCII decimal digits and limb-sized chunks***
+// Eight digits are validated and converted at once as the bytes of a 64-bit word, sixteen
+// with SSE4.1 if the CPU supports it (unless BIG_INTEGER_KERNELS is set to "portable").
+// Chunks are written two digits at a time from a table of all pairs. Other bases up to 36
+// go digit by digit, with the letters a-z (or A-Z when parsing) for digits from 10.
+
+namespace digits {
+  typedef big_integer::limb_t limb_t;
+
+  // value = the n ASCII decimal digits at s, n <= std::numeric_limits<limb_t>::digits10;
+  // returns false (value is then unspecified) if any of them is not a digit
+  bool parse_chunk(char const *s, size_t n, limb_t &value);
+
+  // the number of decimal digits of value, 0 for zero
+  size_t chunk_length(limb_t value);
+
+  // writes the n low decimal digits of value to out, with leading zeros,
+  // n <= std::numeric_limits<limb_t>::digits10 + 1
+  void format_chunk(char *out, limb_t value, size_t n);
+
+  // the same in base 2 <= base <= 36, n is at most the number of digits of the limb maximum
+  bool parse_chunk(char const *s, size_t n, unsigned base, limb_t &value);
+  size_t chunk_length(limb_t value, unsigned base);
+  void format_chunk(char *out, limb_t value, size_t n, unsigned base);
+
+  // the value of a single digit character, or 36 if c is not one
+  unsigned digit_value(char c);
+  // the character of a digit 0 <= d < 36
+  char digit_char(unsigned d);
+}
+
+#endif // BIG_INTEGER_DIGITS_H
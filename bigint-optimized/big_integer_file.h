@@ -0,0 +1,28 @@
+#ifndef BIG_INTEGER_FILE_H
+#define BIG_INTEGER_FILE_H
+
+#include <string>
+#include <vector>
+#include "big_integer.h"
+
+// ***bulk load and dump of files of numbers***
+// The files are memory-mapped and the numbers are parsed and written in place, split
+// into chunks converted by separate threads.
+//
+// decimal: numbers in base 10, separated by whitespace (written one per line)
+// binary: each number is an 8-byte little-endian header 2 * n + sign followed by the
+//         n bytes of its magnitude, least significant first
+
+enum class file_format { decimal, binary };
+
+// reads all numbers from the file at path with up to threads threads (0 is one per hardware
+// thread); throws std::runtime_error if the file cannot be read or holds an invalid number
+std::vector<big_integer> load_file(std::string const &path, file_format format,
+                                   unsigned threads = 0);
+
+// replaces the file at path with the numbers from values; throws std::runtime_error
+// if it cannot be written
+void dump_file(std::string const &path, std::vector<big_integer> const &values,
+               file_format format, unsigned threads = 0);
+
+#endif // BIG_INTEGER_FILE_H
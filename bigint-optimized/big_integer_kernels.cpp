@@ -0,0 +1,523 @@
+#include "big_integer_kernels.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(BIG_INTEGER_64BIT_LIMBS)
+#define BIG_INTEGER_X86_64_KERNELS
+#include <cpuid.h>
+#endif
+
+namespace {
+  using limb_t = big_integer::limb_t;
+  using dlimb_t = big_integer::dlimb_t;
+  const unsigned LIMB_T_BITS = std::numeric_limits<limb_t>::digits;
+}
+
+// ***portable kernels***
+
+namespace portable {
+  limb_t add_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n) {
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+      limb_t s = a[i] + b[i];
+      limb_t c1 = s < a[i];
+      limb_t t = s + carry;
+      limb_t c2 = t < s;
+      r[i] = t;
+      carry = c1 | c2;
+    }
+    return carry;
+  }
+
+  limb_t sub_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n) {
+    limb_t borrow = 0;
+    for (size_t i = 0; i < n; i++) {
+      limb_t d = a[i] - b[i];
+      limb_t b1 = d > a[i];
+      limb_t t = d - borrow;
+      limb_t b2 = t > d;
+      r[i] = t;
+      borrow = b1 | b2;
+    }
+    return borrow;
+  }
+
+  limb_t mul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+      dlimb_t t = static_cast<dlimb_t>(a[i]) * b + carry;
+      r[i] = static_cast<limb_t>(t);
+      carry = static_cast<limb_t>(t >> LIMB_T_BITS);
+    }
+    return carry;
+  }
+
+  limb_t addmul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+      // (B - 1)^2 + 2 * (B - 1) = B^2 - 1 always fits
+      dlimb_t t = static_cast<dlimb_t>(a[i]) * b + r[i] + carry;
+      r[i] = static_cast<limb_t>(t);
+      carry = static_cast<limb_t>(t >> LIMB_T_BITS);
+    }
+    return carry;
+  }
+
+  limb_t submul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+      dlimb_t t = static_cast<dlimb_t>(a[i]) * b + carry;
+      limb_t low = static_cast<limb_t>(t);
+      limb_t d = r[i] - low;
+      carry = static_cast<limb_t>(t >> LIMB_T_BITS) + (d > r[i]);
+      r[i] = d;
+    }
+    return carry;
+  }
+}
+
+// ***x86-64 kernels***
+// mulx (BMI2) does not touch the flags, and adcx/adox (ADX) propagate two independent carry
+// chains through CF and OF, so addmul_1 keeps the carries of the product limbs and of the sum
+// in flight at once. The loops advance with lea and exit with jrcxz, which preserve the flags;
+// they are unrolled by four limbs with a limb-by-limb tail.
+
+#ifdef BIG_INTEGER_X86_64_KERNELS
+namespace bmi2_adx {
+  __attribute__((target("bmi2,adx")))
+  limb_t add_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n) {
+    size_t blocks = n / 4, rest = n % 4;
+    limb_t t;
+    asm volatile(
+      "xor %k[t], %k[t]\n\t"
+      "jrcxz 2f\n"
+      "1:\n\t"
+      "mov (%[a]), %[t]\n\t"
+      "adcx (%[b]), %[t]\n\t"
+      "mov %[t], (%[r])\n\t"
+      "mov 8(%[a]), %[t]\n\t"
+      "adcx 8(%[b]), %[t]\n\t"
+      "mov %[t], 8(%[r])\n\t"
+      "mov 16(%[a]), %[t]\n\t"
+      "adcx 16(%[b]), %[t]\n\t"
+      "mov %[t], 16(%[r])\n\t"
+      "mov 24(%[a]), %[t]\n\t"
+      "adcx 24(%[b]), %[t]\n\t"
+      "mov %[t], 24(%[r])\n\t"
+      "lea 32(%[a]), %[a]\n\t"
+      "lea 32(%[b]), %[b]\n\t"
+      "lea 32(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jrcxz 2f\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov %[rest], %[cnt]\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mov (%[a]), %[t]\n\t"
+      "adcx (%[b]), %[t]\n\t"
+      "mov %[t], (%[r])\n\t"
+      "lea 8(%[a]), %[a]\n\t"
+      "lea 8(%[b]), %[b]\n\t"
+      "lea 8(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "mov $0, %k[t]\n\t"
+      "setc %b[t]"
+      : [r] "+r" (r), [a] "+r" (a), [b] "+r" (b), [cnt] "+c" (blocks), [t] "=&r" (t)
+      : [rest] "r" (rest)
+      : "cc", "memory");
+    return t;
+  }
+
+  __attribute__((target("bmi2,adx")))
+  limb_t sub_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n) {
+    size_t blocks = n / 4, rest = n % 4;
+    limb_t t;
+    asm volatile(
+      "xor %k[t], %k[t]\n\t"
+      "jrcxz 2f\n"
+      "1:\n\t"
+      "mov (%[a]), %[t]\n\t"
+      "sbb (%[b]), %[t]\n\t"
+      "mov %[t], (%[r])\n\t"
+      "mov 8(%[a]), %[t]\n\t"
+      "sbb 8(%[b]), %[t]\n\t"
+      "mov %[t], 8(%[r])\n\t"
+      "mov 16(%[a]), %[t]\n\t"
+      "sbb 16(%[b]), %[t]\n\t"
+      "mov %[t], 16(%[r])\n\t"
+      "mov 24(%[a]), %[t]\n\t"
+      "sbb 24(%[b]), %[t]\n\t"
+      "mov %[t], 24(%[r])\n\t"
+      "lea 32(%[a]), %[a]\n\t"
+      "lea 32(%[b]), %[b]\n\t"
+      "lea 32(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jrcxz 2f\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov %[rest], %[cnt]\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mov (%[a]), %[t]\n\t"
+      "sbb (%[b]), %[t]\n\t"
+      "mov %[t], (%[r])\n\t"
+      "lea 8(%[a]), %[a]\n\t"
+      "lea 8(%[b]), %[b]\n\t"
+      "lea 8(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "mov $0, %k[t]\n\t"
+      "setc %b[t]"
+      : [r] "+r" (r), [a] "+r" (a), [b] "+r" (b), [cnt] "+c" (blocks), [t] "=&r" (t)
+      : [rest] "r" (rest)
+      : "cc", "memory");
+    return t;
+  }
+
+  // r[i] = lo_i + hi_{i-1} + CF, a single chain
+  __attribute__((target("bmi2,adx")))
+  limb_t mul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    size_t blocks = n / 4, rest = n % 4;
+    limb_t hi = 0, lo, hi2;
+    asm volatile(
+      "xor %k[lo], %k[lo]\n\t"
+      "jrcxz 2f\n"
+      "1:\n\t"
+      "mulx (%[a]), %[lo], %[hi2]\n\t"
+      "adcx %[hi], %[lo]\n\t"
+      "mov %[lo], (%[r])\n\t"
+      "mulx 8(%[a]), %[lo], %[hi]\n\t"
+      "adcx %[hi2], %[lo]\n\t"
+      "mov %[lo], 8(%[r])\n\t"
+      "mulx 16(%[a]), %[lo], %[hi2]\n\t"
+      "adcx %[hi], %[lo]\n\t"
+      "mov %[lo], 16(%[r])\n\t"
+      "mulx 24(%[a]), %[lo], %[hi]\n\t"
+      "adcx %[hi2], %[lo]\n\t"
+      "mov %[lo], 24(%[r])\n\t"
+      "lea 32(%[a]), %[a]\n\t"
+      "lea 32(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jrcxz 2f\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov %[rest], %[cnt]\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mulx (%[a]), %[lo], %[hi2]\n\t"
+      "adcx %[hi], %[lo]\n\t"
+      "mov %[lo], (%[r])\n\t"
+      "mov %[hi2], %[hi]\n\t"
+      "lea 8(%[a]), %[a]\n\t"
+      "lea 8(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "mov $0, %k[lo]\n\t"
+      "adcx %[lo], %[hi]"
+      : [r] "+r" (r), [a] "+r" (a), [cnt] "+c" (blocks),
+        [hi] "+r" (hi), [lo] "=&r" (lo), [hi2] "=&r" (hi2)
+      : [rest] "r" (rest), "d" (b)
+      : "cc", "memory");
+    return hi;
+  }
+
+  // the product limbs s_i = lo_i + hi_{i-1} are summed on OF, r[i] + s_i on CF
+  __attribute__((target("bmi2,adx")))
+  limb_t addmul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    size_t blocks = n / 4, rest = n % 4;
+    limb_t hi = 0, lo, hi2;
+    asm volatile(
+      "xor %k[lo], %k[lo]\n\t"
+      "jrcxz 2f\n"
+      "1:\n\t"
+      "mulx (%[a]), %[lo], %[hi2]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "adcx (%[r]), %[lo]\n\t"
+      "mov %[lo], (%[r])\n\t"
+      "mulx 8(%[a]), %[lo], %[hi]\n\t"
+      "adox %[hi2], %[lo]\n\t"
+      "adcx 8(%[r]), %[lo]\n\t"
+      "mov %[lo], 8(%[r])\n\t"
+      "mulx 16(%[a]), %[lo], %[hi2]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "adcx 16(%[r]), %[lo]\n\t"
+      "mov %[lo], 16(%[r])\n\t"
+      "mulx 24(%[a]), %[lo], %[hi]\n\t"
+      "adox %[hi2], %[lo]\n\t"
+      "adcx 24(%[r]), %[lo]\n\t"
+      "mov %[lo], 24(%[r])\n\t"
+      "lea 32(%[a]), %[a]\n\t"
+      "lea 32(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jrcxz 2f\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov %[rest], %[cnt]\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mulx (%[a]), %[lo], %[hi2]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "adcx (%[r]), %[lo]\n\t"
+      "mov %[lo], (%[r])\n\t"
+      "mov %[hi2], %[hi]\n\t"
+      "lea 8(%[a]), %[a]\n\t"
+      "lea 8(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "mov $0, %k[lo]\n\t"
+      "adox %[lo], %[hi]\n\t"
+      "adcx %[lo], %[hi]"
+      : [r] "+r" (r), [a] "+r" (a), [cnt] "+c" (blocks),
+        [hi] "+r" (hi), [lo] "=&r" (lo), [hi2] "=&r" (hi2)
+      : [rest] "r" (rest), "d" (b)
+      : "cc", "memory");
+    return hi;
+  }
+
+  // r - s = r + ~s + 1 - B^n: the product limbs s_i are summed on OF as in addmul_1,
+  // r[i] + ~s_i on CF, which starts at 1; the final CF is 1 iff there is no borrow
+  __attribute__((target("bmi2,adx")))
+  limb_t submul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    size_t blocks = n / 4, rest = n % 4;
+    limb_t hi = 0, lo, hi2;
+    asm volatile(
+      "xor %k[lo], %k[lo]\n\t"
+      "stc\n\t"
+      "jrcxz 2f\n"
+      "1:\n\t"
+      "mulx (%[a]), %[lo], %[hi2]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "not %[lo]\n\t"
+      "adcx (%[r]), %[lo]\n\t"
+      "mov %[lo], (%[r])\n\t"
+      "mulx 8(%[a]), %[lo], %[hi]\n\t"
+      "adox %[hi2], %[lo]\n\t"
+      "not %[lo]\n\t"
+      "adcx 8(%[r]), %[lo]\n\t"
+      "mov %[lo], 8(%[r])\n\t"
+      "mulx 16(%[a]), %[lo], %[hi2]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "not %[lo]\n\t"
+      "adcx 16(%[r]), %[lo]\n\t"
+      "mov %[lo], 16(%[r])\n\t"
+      "mulx 24(%[a]), %[lo], %[hi]\n\t"
+      "adox %[hi2], %[lo]\n\t"
+      "not %[lo]\n\t"
+      "adcx 24(%[r]), %[lo]\n\t"
+      "mov %[lo], 24(%[r])\n\t"
+      "lea 32(%[a]), %[a]\n\t"
+      "lea 32(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jrcxz 2f\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov %[rest], %[cnt]\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mulx (%[a]), %[lo], %[hi2]\n\t"
+      "adox %[hi], %[lo]\n\t"
+      "not %[lo]\n\t"
+      "adcx (%[r]), %[lo]\n\t"
+      "mov %[lo], (%[r])\n\t"
+      "mov %[hi2], %[hi]\n\t"
+      "lea 8(%[a]), %[a]\n\t"
+      "lea 8(%[r]), %[r]\n\t"
+      "lea -1(%[cnt]), %[cnt]\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "mov $0, %k[lo]\n\t"
+      "adox %[lo], %[hi]\n\t"
+      "cmc\n\t"
+      "adcx %[lo], %[hi]"
+      : [r] "+r" (r), [a] "+r" (a), [cnt] "+c" (blocks),
+        [hi] "+r" (hi), [lo] "=&r" (lo), [hi2] "=&r" (hi2)
+      : [rest] "r" (rest), "d" (b)
+      : "cc", "memory");
+    return hi;
+  }
+}
+#endif
+
+// ***dispatch***
+
+namespace {
+  struct kernel_table {
+    limb_t (*add_n)(limb_t *, limb_t const *, limb_t const *, size_t);
+    limb_t (*sub_n)(limb_t *, limb_t const *, limb_t const *, size_t);
+    limb_t (*mul_1)(limb_t *, limb_t const *, size_t, limb_t);
+    limb_t (*addmul_1)(limb_t *, limb_t const *, size_t, limb_t);
+    limb_t (*submul_1)(limb_t *, limb_t const *, size_t, limb_t);
+  };
+
+  constexpr kernel_table PORTABLE_KERNELS = {
+    portable::add_n, portable::sub_n, portable::mul_1, portable::addmul_1, portable::submul_1
+  };
+
+#ifdef BIG_INTEGER_X86_64_KERNELS
+  constexpr kernel_table BMI2_ADX_KERNELS = {
+    bmi2_adx::add_n, bmi2_adx::sub_n, bmi2_adx::mul_1, bmi2_adx::addmul_1, bmi2_adx::submul_1
+  };
+
+  bool cpu_has_bmi2_adx() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+      return false;
+    }
+    return (ebx & bit_BMI2) && (ebx & bit_ADX);
+  }
+#endif
+
+  // constant-initialized, so the kernels are usable during static initialization
+  // of other translation units, before the startup selection below has run
+  kernel_table active_table = PORTABLE_KERNELS;
+  limbs::kernel_set active_set = limbs::kernel_set::portable;
+
+  limbs::kernel_set startup_kernels() {
+    char const *forced = std::getenv("BIG_INTEGER_KERNELS");
+    if (forced != nullptr && std::strcmp(forced, "portable") == 0) {
+      return limbs::kernel_set::portable;
+    }
+    return limbs::kernel_supported(limbs::kernel_set::bmi2_adx)
+           ? limbs::kernel_set::bmi2_adx
+           : limbs::kernel_set::portable;
+  }
+
+  const bool STARTUP_SELECTED = limbs::select_kernels(startup_kernels());
+}
+
+namespace limbs {
+  bool kernel_supported(kernel_set set) {
+    switch (set) {
+      case kernel_set::portable:
+        return true;
+      case kernel_set::bmi2_adx:
+#ifdef BIG_INTEGER_X86_64_KERNELS
+        return cpu_has_bmi2_adx();
+#else
+        return false;
+#endif
+    }
+    return false;
+  }
+
+  kernel_set active_kernels() {
+    return active_set;
+  }
+
+  bool select_kernels(kernel_set set) {
+    if (!kernel_supported(set)) {
+      return false;
+    }
+#ifdef BIG_INTEGER_X86_64_KERNELS
+    active_table = set == kernel_set::bmi2_adx ? BMI2_ADX_KERNELS : PORTABLE_KERNELS;
+#endif
+    active_set = set;
+    return true;
+  }
+
+  limb_t add_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n) {
+    return active_table.add_n(r, a, b, n);
+  }
+
+  limb_t sub_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n) {
+    return active_table.sub_n(r, a, b, n);
+  }
+
+  limb_t mul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    return active_table.mul_1(r, a, n, b);
+  }
+
+  limb_t addmul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    return active_table.addmul_1(r, a, n, b);
+  }
+
+  limb_t submul_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    return active_table.submul_1(r, a, n, b);
+  }
+
+  limb_t add_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    size_t i = 0;
+    for (; i < n && b != 0; i++) {
+      limb_t t = a[i] + b;
+      b = t < b;
+      r[i] = t;
+    }
+    for (; i < n && r != a; i++) {
+      r[i] = a[i];
+    }
+    return b;
+  }
+
+  limb_t sub_1(limb_t *r, limb_t const *a, size_t n, limb_t b) {
+    size_t i = 0;
+    for (; i < n && b != 0; i++) {
+      limb_t t = a[i] - b;
+      b = t > a[i];
+      r[i] = t;
+    }
+    for (; i < n && r != a; i++) {
+      r[i] = a[i];
+    }
+    return b;
+  }
+
+  limb_t add(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m) {
+    return add_1(r + m, a + m, n - m, add_n(r, a, b, m));
+  }
+
+  limb_t sub(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m) {
+    return sub_1(r + m, a + m, n - m, sub_n(r, a, b, m));
+  }
+
+  limb_t lshift(limb_t *r, limb_t const *a, size_t n, unsigned shift) {
+    if (n == 0) {
+      return 0;
+    }
+    limb_t out = a[n - 1] >> (LIMB_T_BITS - shift);
+    for (size_t i = n - 1; i > 0; i--) {
+      r[i] = (a[i] << shift) | (a[i - 1] >> (LIMB_T_BITS - shift));
+    }
+    r[0] = a[0] << shift;
+    return out;
+  }
+
+  limb_t rshift(limb_t *r, limb_t const *a, size_t n, unsigned shift) {
+    if (n == 0) {
+      return 0;
+    }
+    limb_t out = a[0] << (LIMB_T_BITS - shift);
+    for (size_t i = 0; i + 1 < n; i++) {
+      r[i] = (a[i] >> shift) | (a[i + 1] << (LIMB_T_BITS - shift));
+    }
+    r[n - 1] = a[n - 1] >> shift;
+    return out;
+  }
+
+  int cmp(limb_t const *a, limb_t const *b, size_t n) {
+    for (size_t i = n; i --> 0;) {
+      if (a[i] != b[i]) {
+        return a[i] > b[i] ? 1 : -1;
+      }
+    }
+    return 0;
+  }
+
+  limb_t neg(limb_t *r, limb_t const *a, size_t n) {
+    // -a = ~a + 1, the increment stops at the lowest non-zero limb of a
+    limb_t carry = 1;
+    for (size_t i = 0; i < n; i++) {
+      limb_t t = ~a[i] + carry;
+      carry &= a[i] == 0;
+      r[i] = t;
+    }
+    return 1 - carry;
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef BIG_INTEGER_KERNELS_H
+#define BIG_INTEGER_KERNELS_H
+
+#include <cstddef>
+#include "big_integer.h"
+
+// ***low-level kernels on raw little-endian limb buffers***
+// All big_integer arithmetic goes through these functions. Carries and borrows are
+// propagated arithmetically, without data-dependent branches in the loops.
+// The result buffer r may coincide with an input buffer, but must not partially overlap it
+// (except for the shifts, see below).
+
+namespace limbs {
+  typedef big_integer::limb_t limb_t;
+
+  // r[0, n) = a[0, n) + b[0, n), returns the carry
+  limb_t add_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n);
+
+  // r[0, n) = a[0, n) - b[0, n), returns the borrow
+  limb_t sub_n(limb_t *r, limb_t const *a, limb_t const *b, size_t n);
+
+  // r[0, n) = a[0, n) + b, returns the carry
+  limb_t add_1(limb_t *r, limb_t const *a, size_t n, limb_t b);
+
+  // r[0, n) = a[0, n) - b, returns the borrow
+  limb_t sub_1(limb_t *r, limb_t const *a, size_t n, limb_t b);
+
+  // r[0, n) = a[0, n) + b[0, m), m <= n, returns the carry
+  limb_t add(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m);
+
+  // r[0, n) = a[0, n) - b[0, m), m <= n, returns the borrow
+  limb_t sub(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m);
+
+  // r[0, n) = a[0, n) * b, returns the high limb of the product
+  limb_t mul_1(limb_t *r, limb_t const *a, size_t n, limb_t b);
+
+  // r[0, n) += a[0, n) * b, returns the carry limb
+  limb_t addmul_1(limb_t *r, limb_t const *a, size_t n, limb_t b);
+
+  // r[0, n) -= a[0, n) * b, returns the borrow limb
+  limb_t submul_1(limb_t *r, limb_t const *a, size_t n, limb_t b);
+
+  // r[0, n) = a[0, n) << shift, 0 < shift < limb width, returns the bits shifted out;
+  // r may overlap with a if r >= a
+  limb_t lshift(limb_t *r, limb_t const *a, size_t n, unsigned shift);
+
+  // r[0, n) = a[0, n) >> shift, 0 < shift < limb width, returns the bits shifted out
+  // (in the high bits of the limb); r may overlap with a if r <= a
+  limb_t rshift(limb_t *r, limb_t const *a, size_t n, unsigned shift);
+
+  // sign of a[0, n) - b[0, n): -1, 0 or 1
+  int cmp(limb_t const *a, limb_t const *b, size_t n);
+
+  // r[0, n) = -a[0, n) mod B^n, returns 0 if a is zero and 1 otherwise
+  limb_t neg(limb_t *r, limb_t const *a, size_t n);
+
+  // ***kernel selection***
+  // add_n, sub_n, mul_1, addmul_1 and submul_1 also have x86-64 versions using mulx, adcx
+  // and adox (with 64-bit limbs only). They are selected at startup if cpuid reports BMI2
+  // and ADX, unless the BIG_INTEGER_KERNELS environment variable is set to "portable".
+  enum class kernel_set { portable, bmi2_adx };
+
+  // whether the set is built in and can run on this CPU
+  bool kernel_supported(kernel_set set);
+
+  kernel_set active_kernels();
+
+  // switches to the set if it is supported, returns whether it is;
+  // not thread-safe, meant for tests and benchmarks
+  bool select_kernels(kernel_set set);
+}
+
+#endif // BIG_INTEGER_KERNELS_H
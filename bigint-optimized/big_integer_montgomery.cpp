@@ -0,0 +1,184 @@
+#include "big_integer_montgomery.h"
+#include "big_integer_barrett.h"
+#include "big_integer_kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+  using limb_t = big_integer::limb_t;
+  const size_t LIMB_T_BITS = std::numeric_limits<limb_t>::digits;
+
+  // -1 / a mod B for an odd a; a is its own inverse modulo 8,
+  // and each Newton step x = x * (2 - a * x) doubles the number of correct low bits
+  limb_t negated_inverse(limb_t a) {
+    limb_t x = a;
+    for (size_t bits = 3; bits < LIMB_T_BITS; bits *= 2) {
+      x = static_cast<limb_t>(x * (2 - a * x));
+    }
+    return static_cast<limb_t>(-x);
+  }
+}
+
+big_integer_montgomery::big_integer_montgomery(big_integer const &mod)
+    : modulus_(mod.is_negative() ? -mod : mod), n_inv_(0)
+{
+  big_integer const &n = modulus_.value();
+  if (n.data_[0] % 2 == 0) {
+    throw std::runtime_error("montgomery: the modulus must be odd");
+  }
+  n_inv_ = negated_inverse(n.data_[0]);
+  r_squared_ = (big_integer(1) << static_cast<int>(2 * n.len() * LIMB_T_BITS)) % modulus_;
+}
+
+big_integer const &big_integer_montgomery::modulus() const {
+  return modulus_.value();
+}
+
+void big_integer_montgomery::reduce(big_integer &t) const {
+  big_integer const &mod = modulus_.value();
+  size_t n = mod.len();
+  limb_t const *m = mod.data_.data();
+  assert(!t.is_negative() && t.len() <= 2 * n);
+  t.data_.resize(2 * n);
+  limb_t *a = t.data_.data();
+  // step i clears a[i]; its carry belongs to a[i + n], so it is parked in the cleared limb
+  // and all of them are added in one pass at the end
+  for (size_t i = 0; i < n; i++) {
+    a[i] = limbs::addmul_1(a + i, m, n, static_cast<limb_t>(a[i] * n_inv_));
+  }
+  // a[n, 2n) + carry * B^n = t / R mod N + (0 or N)
+  limb_t carry = limbs::add_n(a + n, a + n, a, n);
+  if (carry != 0 || limbs::cmp(a + n, m, n) >= 0) {
+    limbs::sub_n(a, a + n, m, n);
+  } else {
+    std::copy_n(a + n, n, a);
+  }
+  t.data_.resize(n);
+  t.normalize();
+}
+
+big_integer big_integer_montgomery::to_montgomery(big_integer const &x) const {
+  big_integer t = x % modulus_;
+  if (t.is_negative()) {
+    t += modulus_.value();
+  }
+  return mulmod(t, r_squared_);
+}
+
+big_integer big_integer_montgomery::from_montgomery(big_integer const &x) const {
+  big_integer t = x;
+  reduce(t);
+  return t;
+}
+
+big_integer big_integer_montgomery::mulmod(big_integer const &a, big_integer const &b) const {
+  big_integer t = a * b;
+  reduce(t);
+  return t;
+}
+
+big_integer big_integer_montgomery::sqrmod(big_integer const &a) const {
+  big_integer t = a;
+  t *= t;
+  reduce(t);
+  return t;
+}
+
+// ***modular exponentiation***
+
+namespace {
+  // the window width k for an exponent of the given length: a larger k saves multiplications
+  // in the main loop, but needs 2^(k - 1) of them to precompute the table
+  size_t window_bits(size_t exp_bits) {
+    const size_t thresholds[] = {8, 24, 80, 240, 672, 1792};
+    size_t k = 1;
+    for (size_t t : thresholds) {
+      if (exp_bits > t) {
+        k++;
+      }
+    }
+    return k;
+  }
+
+  // g^e with the mulmod and sqrmod of ring (a Montgomery or Barrett context), e[0, en) is
+  // nonzero and has no leading zero limbs; sliding windows: g, g^3, ..., g^(2^k - 1) are
+  // precomputed, and every run of at most k exponent bits that starts and ends with a one
+  // takes a single multiplication
+  template<typename Ring>
+  big_integer sliding_window_pow(Ring const &ring, big_integer const &g, limb_t const *e, size_t en) {
+    auto bit = [e](size_t i) {
+      return static_cast<size_t>(e[i / LIMB_T_BITS] >> (i % LIMB_T_BITS)) & 1;
+    };
+    size_t exp_bits = en * LIMB_T_BITS;
+    while (bit(exp_bits - 1) == 0) {
+      exp_bits--;
+    }
+    size_t k = window_bits(exp_bits);
+    std::vector<big_integer> odd_powers(static_cast<size_t>(1) << (k - 1));
+    odd_powers[0] = g;
+    if (k > 1) {
+      big_integer g_squared = ring.sqrmod(g);
+      for (size_t i = 1; i < odd_powers.size(); i++) {
+        odd_powers[i] = ring.mulmod(odd_powers[i - 1], g_squared);
+      }
+    }
+    // the top bit is set, so the first window initializes res
+    big_integer res;
+    bool started = false;
+    for (size_t i = exp_bits; i > 0;) {
+      if (bit(i - 1) == 0) {
+        res = ring.sqrmod(res);
+        i--;
+        continue;
+      }
+      // the window is bits [j, i), with bit j set
+      size_t j = i > k ? i - k : 0;
+      while (bit(j) == 0) {
+        j++;
+      }
+      size_t w = 0;
+      for (size_t b = i; b > j; b--) {
+        w = 2 * w + bit(b - 1);
+      }
+      if (started) {
+        for (size_t s = j; s < i; s++) {
+          res = ring.sqrmod(res);
+        }
+        res = ring.mulmod(res, odd_powers[w / 2]);
+      } else {
+        res = odd_powers[w / 2];
+        started = true;
+      }
+      i = j;
+    }
+    return res;
+  }
+}
+
+big_integer powm(big_integer const &base, big_integer const &exp, big_integer const &mod)
+{
+  if (mod.is_zero()) {
+    throw std::runtime_error("powm: zero modulus");
+  }
+  if (exp.is_negative()) {
+    throw std::runtime_error("powm: negative exponent");
+  }
+  big_integer n = mod.is_negative() ? -mod : mod;
+  if (n == 1) {
+    return 0;
+  }
+  if (exp.is_zero()) {
+    return 1;
+  }
+  if (n.data_[0] % 2 != 0) {
+    big_integer_montgomery ctx(n);
+    big_integer res = sliding_window_pow(ctx, ctx.to_montgomery(base), exp.data_.data(), exp.len());
+    return ctx.from_montgomery(res);
+  }
+  big_integer_barrett ctx(n);
+  return sliding_window_pow(ctx, ctx.reduce(base), exp.data_.data(), exp.len());
+}
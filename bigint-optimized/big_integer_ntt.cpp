@@ -0,0 +1,169 @@
+#include "big_integer_ntt.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace {
+  using limb_t = big_integer::limb_t;
+
+  const size_t COEFF_BITS = 32;
+  const size_t COEFFS_PER_LIMB = std::numeric_limits<limb_t>::digits / COEFF_BITS;
+  // p1 * p2 * p3 > 2^87 > 2^22 * (2^32 - 1)^2, so every coefficient of the convolution
+  // is restored exactly while the shorter operand has at most 2^22 coefficients
+  const size_t MAX_SHORT_COEFFS = static_cast<size_t>(1) << 22;
+  // 2^25 divides p - 1 for each of the primes
+  const size_t MAX_TRANSFORM_LEN = static_cast<size_t>(1) << 25;
+
+  template<uint32_t P, uint32_t G>
+  struct prime_field {
+    static const uint32_t MOD = P;
+
+    static uint32_t add(uint32_t a, uint32_t b) {
+      uint32_t s = a + b;
+      return s >= P ? s - P : s;
+    }
+
+    static uint32_t sub(uint32_t a, uint32_t b) {
+      return a >= b ? a - b : a + (P - b);
+    }
+
+    static uint32_t mul(uint32_t a, uint32_t b) {
+      return static_cast<uint32_t>(static_cast<uint64_t>(a) * b % P);
+    }
+
+    static uint32_t pow(uint32_t a, uint64_t e) {
+      uint32_t res = 1;
+      for (; e > 0; e /= 2, a = mul(a, a)) {
+        if (e % 2 == 1) {
+          res = mul(res, a);
+        }
+      }
+      return res;
+    }
+
+    static uint32_t inverse(uint32_t a) {
+      return pow(a, P - 2);
+    }
+
+    static void transform(std::vector<uint32_t> &a, bool invert) {
+      size_t n = a.size();
+      for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+          j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+          std::swap(a[i], a[j]);
+        }
+      }
+      std::vector<uint32_t> roots(n / 2);
+      for (size_t len = 2; len <= n; len <<= 1) {
+        uint32_t root = pow(G, (P - 1) / len);
+        if (invert) {
+          root = inverse(root);
+        }
+        size_t half = len / 2;
+        roots[0] = 1;
+        for (size_t j = 1; j < half; j++) {
+          roots[j] = mul(roots[j - 1], root);
+        }
+        for (size_t i = 0; i < n; i += len) {
+          for (size_t j = 0; j < half; j++) {
+            uint32_t u = a[i + j], v = mul(a[i + j + half], roots[j]);
+            a[i + j] = add(u, v);
+            a[i + j + half] = sub(u, v);
+          }
+        }
+      }
+      if (invert) {
+        uint32_t n_inv = inverse(static_cast<uint32_t>(n % P));
+        for (auto &x : a) {
+          x = mul(x, n_inv);
+        }
+      }
+    }
+
+    // cyclic convolution of fa and fb modulo P, both of them are of the same length;
+    // an empty fb stands for fb = fa
+    static std::vector<uint32_t> convolve(std::vector<uint32_t> fa, std::vector<uint32_t> fb) {
+      for (auto *v : {&fa, &fb}) {
+        for (auto &x : *v) {
+          x %= P;
+        }
+        transform(*v, false);
+      }
+      for (size_t i = 0; i < fa.size(); i++) {
+        fa[i] = mul(fa[i], fb.empty() ? fa[i] : fb[i]);
+      }
+      transform(fa, true);
+      return fa;
+    }
+  };
+
+  typedef prime_field<2013265921, 31> field1;  // 15 * 2^27 + 1
+  typedef prime_field<469762049, 3> field2;    //  7 * 2^26 + 1
+  typedef prime_field<167772161, 3> field3;    //  5 * 2^25 + 1
+
+  size_t transform_len(size_t coeffs) {
+    size_t len = 1;
+    while (len < coeffs) {
+      len *= 2;
+    }
+    return len;
+  }
+
+  std::vector<uint32_t> to_coeffs(limb_t const *a, size_t n, size_t len) {
+    std::vector<uint32_t> res(len);
+    for (size_t i = 0; i < n * COEFFS_PER_LIMB; i++) {
+      res[i] = static_cast<uint32_t>(a[i / COEFFS_PER_LIMB] >> (COEFF_BITS * (i % COEFFS_PER_LIMB)));
+    }
+    return res;
+  }
+
+  // acc += x, where acc = {hi, lo} is a 128-bit accumulator
+  void add_wide(uint64_t &lo, uint64_t &hi, uint64_t x) {
+    lo += x;
+    hi += lo < x ? 1 : 0;
+  }
+}
+
+bool ntt_fits(size_t n, size_t m) {
+  return std::min(n, m) * COEFFS_PER_LIMB <= MAX_SHORT_COEFFS
+         && transform_len((n + m) * COEFFS_PER_LIMB) <= MAX_TRANSFORM_LEN;
+}
+
+void ntt_mul(limb_t *r, limb_t const *a, size_t n, limb_t const *b, size_t m) {
+  size_t coeffs = (n + m) * COEFFS_PER_LIMB;
+  size_t len = transform_len(coeffs);
+  auto fa = to_coeffs(a, n, len);
+  auto fb = a == b && n == m ? std::vector<uint32_t>() : to_coeffs(b, m, len);
+  auto c1 = field1::convolve(fa, fb);
+  auto c2 = field2::convolve(fa, fb);
+  auto c3 = field3::convolve(std::move(fa), std::move(fb));
+
+  // Garner's algorithm: x = t1 + p1 * t2 + p1 * p2 * t3
+  const uint64_t p1 = field1::MOD, p1p2 = p1 * field2::MOD;
+  const uint32_t p1_inv = field2::inverse(field1::MOD % field2::MOD);
+  const uint32_t p1p2_inv = field3::inverse(p1p2 % field3::MOD);
+  std::fill_n(r, n + m, 0);
+  uint64_t acc_lo = 0, acc_hi = 0;
+  for (size_t i = 0; i < coeffs; i++) {
+    uint32_t t1 = c1[i];
+    uint32_t t2 = field2::mul(field2::sub(c2[i], t1 % field2::MOD), p1_inv);
+    uint64_t low = t1 + p1 * t2;
+    uint32_t t3 = field3::mul(field3::sub(c3[i], low % field3::MOD), p1p2_inv);
+    uint64_t mid = (p1p2 & 0xffffffff) * t3, high = (p1p2 >> 32) * t3;
+
+    add_wide(acc_lo, acc_hi, low);
+    add_wide(acc_lo, acc_hi, mid);
+    add_wide(acc_lo, acc_hi, high << 32);
+    acc_hi += high >> 32;
+
+    r[i / COEFFS_PER_LIMB] |= static_cast<limb_t>(static_cast<uint32_t>(acc_lo))
+            << (COEFF_BITS * (i % COEFFS_PER_LIMB));
+    acc_lo = (acc_lo >> 32) | (acc_hi << 32);
+    acc_hi >>= 32;
+  }
+}
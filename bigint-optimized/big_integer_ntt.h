@@ -0,0 +1,19 @@
+#ifndef BIG_INTEGER_NTT_H
+#define BIG_INTEGER_NTT_H
+
+#include <cstddef>
+#include "big_integer.h"
+
+// ***multiplication by three-prime number-theoretic transform***
+// Limbs are cut into 32-bit coefficients, their convolution is computed modulo
+// three NTT-friendly primes and restored by the Chinese remainder theorem.
+
+// whether a product of n-limb and m-limb numbers is small enough for the convolution to be exact
+bool ntt_fits(size_t n, size_t m);
+
+// r[0, n + m) = a[0, n) * b[0, m), requires ntt_fits(n, m), r must not overlap with a or b
+void ntt_mul(big_integer::limb_t *r,
+             big_integer::limb_t const *a, size_t n,
+             big_integer::limb_t const *b, size_t m);
+
+#endif // BIG_INTEGER_NTT_H
@@ -1,13 +1,53 @@
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
 #include <random>
+#include <sstream>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <utility>
 #include <gtest/gtest.h>
+#include <unistd.h>
 
 #include "big_integer.h"
 #include "big_integer_gmp.h"
+#include "big_integer_barrett.h"
+#include "big_integer_digits.h"
+#include "big_integer_expr.h"
+#include "big_integer_file.h"
+#include "big_integer_kernels.h"
+#include "big_integer_montgomery.h"
+#include "big_integer_ntt.h"
+
+namespace {
+size_t allocation_count = 0;
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+// once inlined, free() looks mismatched with the new-expressions that called operator new
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+// counts heap allocations, see div_allocations
+void* operator new(size_t size) {
+  allocation_count++;
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
 
 TEST(correctness, two_plus_two) {
   EXPECT_EQ(big_integer(4), big_integer(2) + big_integer(2));
@@ -241,6 +281,108 @@ TEST(correctness, div_rounding_negative) {
   EXPECT_TRUE(c % d == -3);
 }
 
+TEST(correctness, divmod) {
+  big_integer a = -23;
+  big_integer b = 5;
+
+  auto qr = divmod(a, b);
+  EXPECT_EQ(-4, qr.first);
+  EXPECT_EQ(-3, qr.second);
+
+  big_integer rem;
+  EXPECT_EQ(4, a.divmod(-b, rem));
+  EXPECT_EQ(-3, rem);
+
+  b.divmod(b, rem);
+  EXPECT_EQ(1, b);
+  EXPECT_EQ(0, rem);
+}
+
+TEST(correctness, divisor) {
+  big_integer_divisor d(-7);
+  EXPECT_EQ(-7, d.value());
+
+  EXPECT_EQ(-3, 23 / d);
+  EXPECT_EQ(2, 23 % d);
+  EXPECT_EQ(3, -23 / d);
+  EXPECT_EQ(-2, -23 % d);
+
+  auto qr = divmod(big_integer(-23), d);
+  EXPECT_EQ(3, qr.first);
+  EXPECT_EQ(-2, qr.second);
+
+  big_integer a = big_integer(1) << 200, rem;
+  a.divmod(big_integer_divisor(big_integer(1) << 100), rem);
+  EXPECT_EQ(big_integer(1) << 100, a);
+  EXPECT_EQ(0, rem);
+
+  EXPECT_THROW(big_integer_divisor(0), std::runtime_error);
+}
+
+TEST(correctness, powm) {
+  // the base is spelled as a big_integer: big_integer_gmp converts from int as well
+  EXPECT_EQ(24, powm(big_integer(2), 10, 1000));
+  EXPECT_EQ(2, powm(big_integer(-2), 3, 5));
+  EXPECT_EQ(3, powm(big_integer(7), 3, -10));
+  EXPECT_EQ(1, powm(big_integer(5), 0, 7));
+  EXPECT_EQ(0, powm(big_integer(5), 0, 1));
+  EXPECT_EQ(0, powm(big_integer(6), 3, 4));
+
+  // Fermat: 2^(p - 1) = 1 mod p for the prime p = 2^127 - 1
+  big_integer p = (big_integer(1) << 127) - 1;
+  EXPECT_EQ(1, powm(big_integer(2), p - 1, p));
+
+  EXPECT_THROW(powm(big_integer(2), 3, 0), std::runtime_error);
+  EXPECT_THROW(powm(big_integer(2), -3, 5), std::runtime_error);
+}
+
+TEST(correctness, montgomery) {
+  big_integer n = (big_integer(1) << 200) + 235;
+  big_integer_montgomery ctx(-n);
+  EXPECT_EQ(n, ctx.modulus());
+
+  big_integer a = (big_integer(1) << 199) + 17, b = -12345;
+  big_integer am = ctx.to_montgomery(a), bm = ctx.to_montgomery(b);
+  EXPECT_EQ(a, ctx.from_montgomery(am));
+  EXPECT_EQ(b + n, ctx.from_montgomery(bm));
+  EXPECT_EQ((a * (b + n)) % n, ctx.from_montgomery(ctx.mulmod(am, bm)));
+  EXPECT_EQ(a * a % n, ctx.from_montgomery(ctx.sqrmod(am)));
+
+  EXPECT_THROW(big_integer_montgomery(n + 1), std::runtime_error);
+}
+
+TEST(correctness, barrett) {
+  big_integer n = big_integer(1) << 100;
+  big_integer_barrett ctx(-(n + 2));
+  EXPECT_EQ(n + 2, ctx.modulus());
+
+  EXPECT_EQ(0, ctx.reduce(0));
+  EXPECT_EQ(5, ctx.reduce(5));
+  EXPECT_EQ(0, ctx.reduce(n + 2));
+  EXPECT_EQ(n - 3, ctx.reduce(-5));
+  EXPECT_EQ(4, ctx.reduce(n * n));
+  EXPECT_EQ(n + 1, ctx.mulmod(n + 1, 1));
+  EXPECT_EQ(1, ctx.sqrmod(n + 1));
+  // beyond B^2k the reduction falls back to division
+  EXPECT_EQ(1, ctx.reduce((n + 2) * n * n * n + 1));
+
+  EXPECT_THROW(big_integer_barrett(0), std::runtime_error);
+}
+
+TEST(correctness, div_allocations) {
+  // schoolbook division allocates a fixed number of buffers per call, none per quotient limb
+  big_integer d = (big_integer(1) << 3000) - 12345;
+  auto allocations = [&d](big_integer const &a) {
+    size_t before = allocation_count;
+    big_integer q = a / d;
+    return allocation_count - before;
+  };
+  size_t short_quotient = allocations((d << 200) + 1);
+  size_t long_quotient = allocations((d << 1500) + 7);
+  EXPECT_EQ(short_quotient, long_quotient);
+  EXPECT_LE(long_quotient, 6u);
+}
+
 TEST(correctness, div_return_value) {
   big_integer a = 100;
   big_integer b = 2;
@@ -451,6 +593,12 @@ TEST(correctness, add_long_signed2) {
   EXPECT_EQ(c, a + b);
 }
 
+TEST(correctness, add_self) {
+  big_integer a = std::numeric_limits<int>::min();
+  a += a;
+  EXPECT_EQ(big_integer(std::numeric_limits<int>::min()) * 2, a);
+}
+
 TEST(correctness, add_long_pow2) {
   big_integer a("18446744073709551616");
   big_integer b("-18446744073709551616");
@@ -504,6 +652,18 @@ TEST(correctness, mul_long_pow2) {
   EXPECT_EQ(c, b * b);
 }
 
+TEST(correctness, mul_long_all_ones) {
+  for (int n = 1000; n <= 64000; n *= 4) {
+    for (int m = n / 2; m <= n; m += n / 4) {
+      big_integer a = (big_integer(1) << n) - 1;
+      big_integer b = (big_integer(1) << m) - 1;
+      big_integer expected = (big_integer(1) << (n + m)) - (big_integer(1) << n) - (big_integer(1) << m) + 1;
+      EXPECT_EQ(expected, a * b);
+      EXPECT_EQ(-expected, -a * b);
+    }
+  }
+}
+
 TEST(correctness, div_long) {
   big_integer a("10000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000");
   big_integer b("100000000000000000000000000000000000000");
@@ -537,6 +697,12 @@ TEST(correctness, negation_long) {
   EXPECT_EQ(-c, a);
 }
 
+TEST(correctness, negation_long_min) {
+  big_integer a = -(big_integer(1) << 127);
+  EXPECT_EQ(big_integer(1) << 127, -a);
+  EXPECT_EQ(a, -(-a));
+}
+
 TEST(correctness, shl_long) {
   EXPECT_EQ(big_integer("1091951238831590836520041079875950759639875963123939936"),
             big_integer("34123476213487213641251283746123461238746123847623123") << 5);
@@ -577,6 +743,434 @@ TEST(correctness, string_conv) {
   EXPECT_EQ("-2147483649", to_string(lim));
 }
 
+TEST(correctness, to_chars) {
+  char buf[64];
+  for (std::string s : {"0", "7", "-1", "1000000000", "-999999999999999999999", "123456789012345678901234567890"}) {
+    big_integer a(s);
+    char *end = to_chars(buf, buf + sizeof(buf), a);
+    ASSERT_NE(nullptr, end);
+    EXPECT_EQ(s, std::string(buf, end));
+    // exactly enough room, and one character too little
+    end = to_chars(buf, buf + s.size(), a);
+    ASSERT_NE(nullptr, end);
+    EXPECT_EQ(s, std::string(buf, end));
+    EXPECT_EQ(nullptr, to_chars(buf, buf + s.size() - 1, a));
+  }
+
+  big_integer big = (big_integer(1) << 20000) - 1;
+  std::string s = to_string(big);
+  std::vector<char> out(s.size());
+  EXPECT_EQ(out.data() + s.size(), to_chars(out.data(), out.data() + s.size(), big));
+  EXPECT_EQ(s, std::string(out.begin(), out.end()));
+  EXPECT_EQ(nullptr, to_chars(out.data(), out.data() + s.size() - 1, big));
+}
+
+TEST(correctness, to_chars_allocations) {
+  big_integer a = -((big_integer(1) << 1000) - 1);
+  char buf[400];
+  size_t before = allocation_count;
+  to_chars(buf, buf + sizeof(buf), a);
+  to_chars(buf, buf + 302, a);
+  EXPECT_EQ(before, allocation_count);
+}
+
+TEST(correctness, format_chunk) {
+  char buf[24];
+  size_t max_len = std::numeric_limits<big_integer::limb_t>::digits10 + 1;
+  for (big_integer::limb_t v : {big_integer::limb_t(0), big_integer::limb_t(5),
+                                big_integer::limb_t(10), big_integer::limb_t(4294967295u),
+                                std::numeric_limits<big_integer::limb_t>::max()}) {
+    std::string expected = std::to_string(v);
+    EXPECT_EQ(v == 0 ? 0 : expected.size(), digits::chunk_length(v));
+    for (size_t len = expected.size(); len <= max_len; ++len) {
+      digits::format_chunk(buf, v, len);
+      EXPECT_EQ(std::string(len - expected.size(), '0') + expected, std::string(buf, len));
+    }
+  }
+  // only the n low digits of longer values
+  big_integer::limb_t v = std::numeric_limits<big_integer::limb_t>::max();
+  std::string digits = std::to_string(v);
+  for (size_t len : {1, 7, 8, 9}) {
+    digits::format_chunk(buf, v, len);
+    EXPECT_EQ(digits.substr(digits.size() - len), std::string(buf, len));
+  }
+}
+
+TEST(correctness, string_bases) {
+  EXPECT_EQ(255, big_integer("ff", 16));
+  EXPECT_EQ(-255, big_integer("-FF", 16));
+  EXPECT_EQ(511, big_integer("777", 8));
+  EXPECT_EQ(5, big_integer("000101", 2));
+  EXPECT_EQ(31, big_integer("v", 32));
+  EXPECT_EQ(35, big_integer("Z", 36));
+  EXPECT_EQ(100, big_integer("10201", 3));
+  EXPECT_EQ(big_integer(1) << 100, big_integer("1" + std::string(25, '0'), 16));
+
+  EXPECT_EQ("-ff", to_string(big_integer(-255), 16));
+  EXPECT_EQ("0", to_string(big_integer(0), 2));
+  EXPECT_EQ("10201", to_string(big_integer(100), 3));
+  EXPECT_EQ("z", to_string(big_integer(35), 36));
+  EXPECT_EQ("1" + std::string(20, '0'), to_string(big_integer(1) << 100, 32));
+
+  EXPECT_THROW(big_integer("8", 8), std::runtime_error);
+  EXPECT_THROW(big_integer("fg", 16), std::runtime_error);
+  EXPECT_THROW(big_integer("-", 16), std::runtime_error);
+  EXPECT_THROW(big_integer("1", 1), std::runtime_error);
+  EXPECT_THROW(big_integer("1", 37), std::runtime_error);
+  EXPECT_THROW(to_string(big_integer(1), 37), std::runtime_error);
+}
+
+TEST(correctness, stream_base) {
+  std::ostringstream s;
+  s << std::hex << big_integer(-255) << ' ' << std::oct << big_integer(8) << ' '
+    << std::showbase << std::uppercase << std::hex << big_integer(-255) << ' ' << big_integer(0)
+    << ' ' << std::oct << big_integer(8) << ' ' << std::dec << big_integer(10);
+  EXPECT_EQ("-ff 10 -0XFF 0 010 10", s.str());
+}
+
+TEST(correctness, limbs_view) {
+  big_integer a = -((big_integer(1) << 200) + 12345);
+  big_integer::limb_span v = a.limbs();
+  ASSERT_EQ(static_cast<size_t>(200 / std::numeric_limits<big_integer::limb_t>::digits + 1), v.size);
+  EXPECT_EQ(12345u, v[0]);
+  EXPECT_EQ(-a, big_integer(v.data, v.size));
+  EXPECT_EQ(a, big_integer(v.data, v.size, true));
+  EXPECT_EQ(1u, big_integer(0).limbs().size);
+
+  big_integer::limb_t padded[] = {7, 0, 0};
+  EXPECT_EQ(7, big_integer(padded, 3));
+  EXPECT_EQ(0, big_integer(padded, 0, true));
+  EXPECT_EQ(1u, big_integer(padded, 3).limbs().size);
+}
+
+TEST(correctness, export_import) {
+  big_integer a = big_integer("0102030405", 16);
+  auto bytes = [&a](size_t word_size, word_order order, byte_order endian) {
+    std::vector<unsigned char> res(export_size(a, word_size) * word_size);
+    EXPECT_EQ(res.size() / word_size, export_bytes(res.data(), a, word_size, order, endian));
+    EXPECT_EQ(a, import_bytes(res.data(), res.size() / word_size, word_size, order, endian));
+    return res;
+  };
+  typedef std::vector<unsigned char> v;
+  EXPECT_EQ(v({1, 2, 3, 4, 5}), bytes(1, word_order::most_significant_first, byte_order::big));
+  EXPECT_EQ(v({5, 4, 3, 2, 1}), bytes(1, word_order::least_significant_first, byte_order::big));
+  EXPECT_EQ(v({0, 1, 2, 3, 4, 5}), bytes(2, word_order::most_significant_first, byte_order::big));
+  EXPECT_EQ(v({1, 0, 3, 2, 5, 4}), bytes(2, word_order::most_significant_first, byte_order::little));
+  EXPECT_EQ(v({4, 5, 2, 3, 0, 1}), bytes(2, word_order::least_significant_first, byte_order::big));
+  EXPECT_EQ(v({5, 4, 3, 2, 1, 0}), bytes(2, word_order::least_significant_first, byte_order::little));
+  EXPECT_EQ(v({5, 4, 3, 2, 1, 0, 0, 0}),
+            bytes(8, word_order::least_significant_first, byte_order::little));
+  EXPECT_EQ(v({0, 0, 1, 2, 3, 4, 5}), bytes(7, word_order::most_significant_first, byte_order::big));
+
+  EXPECT_EQ(0u, export_size(0, 4));
+  EXPECT_EQ(0, import_bytes(nullptr, 0, 4));
+  EXPECT_EQ(2u, export_size(-a, 4));
+}
+
+TEST(correctness, stream_in) {
+  std::istringstream s("  -123abc +5\t077 ff x");
+  big_integer a, b, c, d;
+  s >> a;
+  EXPECT_EQ(-123, a);
+  EXPECT_EQ('a', s.peek());
+  s >> std::hex >> b >> std::dec >> a >> std::oct >> c >> std::hex >> d;
+  EXPECT_EQ(0xabc, b);
+  EXPECT_EQ(5, a);
+  EXPECT_EQ(077, c);
+  EXPECT_EQ(0xff, d);
+  EXPECT_TRUE(s.good());
+
+  s >> a;
+  EXPECT_TRUE(s.fail());
+  EXPECT_EQ(5, a);
+
+  std::istringstream t("42");
+  t >> a;
+  EXPECT_EQ(42, a);
+  EXPECT_TRUE(t.eof());
+  EXPECT_FALSE(t.fail());
+  t.clear();
+  t >> a;
+  EXPECT_TRUE(t.fail());
+
+  std::istringstream u("-");
+  u >> a;
+  EXPECT_TRUE(u.fail());
+  EXPECT_EQ(42, a);
+}
+
+TEST(correctness, stream_in_prefix) {
+  // std::hex takes 0x or 0X after the sign, as the built-in types do
+  std::istringstream s("0x1f -0XABCDEF0123456789abcdef 0 +0xz 0x");
+  big_integer a, b, c;
+  s >> std::hex >> a >> b >> c;
+  EXPECT_EQ(0x1f, a);
+  EXPECT_EQ(big_integer("-ABCDEF0123456789abcdef", 16), b);
+  EXPECT_EQ(0, c);
+  s >> a;
+  EXPECT_TRUE(s.fail());
+  EXPECT_EQ(0x1f, a);
+  s.clear();
+  s.ignore(1);
+  s >> a;
+  EXPECT_TRUE(s.fail());
+  EXPECT_TRUE(s.eof());
+  EXPECT_EQ(0x1f, a);
+
+  // the 0 of std::oct is a digit, and 0x is only a prefix in base 16
+  std::istringstream t("017 0x10");
+  t >> std::oct >> a >> std::dec >> b;
+  EXPECT_EQ(017, a);
+  EXPECT_EQ(0, b);
+  EXPECT_EQ('x', t.peek());
+}
+
+TEST(correctness, stream_long) {
+  // longer than one output block in every base
+  big_integer a = -((big_integer(1) << 300000) - 12345);
+  for (auto base : {std::dec, std::hex, std::oct}) {
+    std::stringstream s;
+    s << base << a;
+    std::string expected = to_string(a, base == std::dec ? 10 : base == std::hex ? 16 : 8);
+    EXPECT_EQ(expected, s.str());
+    big_integer b;
+    s >> base >> b;
+    EXPECT_EQ(a, b);
+  }
+  std::ostringstream s;
+  s << std::setw(6) << big_integer(42) << std::setw(6) << std::left << std::hex
+    << std::showbase << big_integer(-255);
+  EXPECT_EQ("    42-0xff ", s.str());
+}
+
+TEST(correctness, file_load_dump) {
+  char path[] = "/tmp/big_integer_testingXXXXXX";
+  close(mkstemp(path));
+  std::vector<big_integer> values;
+  for (int i = 0; i < 3000; i++) {
+    big_integer a = (big_integer(i) << (i % 997)) - 1000;
+    values.push_back(i % 3 == 0 ? -a : a);
+  }
+  // sizes from several chunks per thread down to a single short file and an empty one
+  for (size_t n : {values.size(), size_t(5), size_t(0)}) {
+    std::vector<big_integer> v(values.begin(), values.begin() + n);
+    for (file_format format : {file_format::decimal, file_format::binary}) {
+      for (unsigned threads : {1u, 4u}) {
+        dump_file(path, v, format, threads);
+        EXPECT_EQ(v, load_file(path, format, threads));
+      }
+    }
+  }
+
+  std::ofstream(path) << "\n  12\t-34\n\n56 ";
+  EXPECT_EQ(std::vector<big_integer>({12, -34, 56}), load_file(path, file_format::decimal));
+  std::ofstream(path) << "12 3x4";
+  EXPECT_THROW(load_file(path, file_format::decimal), std::runtime_error);
+  // a header for 2 bytes followed by 1
+  std::ofstream(path).write("\x04\0\0\0\0\0\0\0\x01", 9);
+  EXPECT_THROW(load_file(path, file_format::binary), std::runtime_error);
+  std::remove(path);
+  EXPECT_THROW(load_file(path, file_format::decimal), std::runtime_error);
+
+  std::string s = "-123456789012345678901234567890";
+  EXPECT_EQ(big_integer(s), big_integer(s.data(), s.data() + s.size()));
+  EXPECT_EQ(big_integer("-123", 16), big_integer(s.data(), s.data() + 4, 16));
+  EXPECT_THROW(big_integer(s.data(), s.data() + 1), std::runtime_error);
+}
+
+TEST(correctness, file_dump_allocations) {
+  // the numbers are written in place: each costs only what to_chars allocates itself
+  char path[] = "/tmp/big_integer_testingXXXXXX";
+  close(mkstemp(path));
+  for (big_integer a : {-((big_integer(1) << 1000) - 1), (big_integer(1) << 5000) - 1}) {
+    std::vector<big_integer> one(1, a), nine(9, a);
+    std::string buf(to_chars_size(a), '\0');
+    size_t before = allocation_count;
+    to_chars(&buf[0], &buf[0] + buf.size(), a);
+    size_t per_number = allocation_count - before;
+    before = allocation_count;
+    dump_file(path, one, file_format::decimal, 1);
+    size_t one_count = allocation_count - before;
+    before = allocation_count;
+    dump_file(path, nine, file_format::decimal, 1);
+    EXPECT_EQ(one_count + 8 * per_number, allocation_count - before);
+    EXPECT_EQ(nine, load_file(path, file_format::decimal));
+  }
+  std::remove(path);
+}
+
+TEST(correctness, move_semantics) {
+  static_assert(std::is_nothrow_move_constructible<big_integer>::value, "");
+  static_assert(std::is_nothrow_move_assignable<big_integer>::value, "");
+  big_integer a = (big_integer(1) << 3200) - 1, c = 12345;
+  size_t before = allocation_count;
+  big_integer b(std::move(a));
+  a = std::move(b);
+  // computed in the buffer of a, which has room for it
+  big_integer r = c - std::move(a);
+  r = -std::move(r);
+  EXPECT_EQ(before, allocation_count);
+  EXPECT_EQ((big_integer(1) << 3200) - 12346, r);
+
+  std::vector<big_integer> v = {big_integer(-70000) << 200, -3, 0, 5, (big_integer(1) << 300) + 7};
+  for (big_integer const &p : v) {
+    EXPECT_EQ(-p, -big_integer(p));
+    EXPECT_EQ(~p, ~big_integer(p));
+    EXPECT_EQ(p, +big_integer(p));
+    for (big_integer const &q : v) {
+      EXPECT_EQ(p + q, p + big_integer(q));
+      EXPECT_EQ(p + q, big_integer(p) + big_integer(q));
+      EXPECT_EQ(p - q, p - big_integer(q));
+      EXPECT_EQ(p - q, big_integer(p) - big_integer(q));
+      EXPECT_EQ(p & q, p & big_integer(q));
+      EXPECT_EQ(p & q, big_integer(p) & big_integer(q));
+      EXPECT_EQ(p | q, p | big_integer(q));
+      EXPECT_EQ(p | q, big_integer(p) | big_integer(q));
+      EXPECT_EQ(p ^ q, p ^ big_integer(q));
+      EXPECT_EQ(p ^ q, big_integer(p) ^ big_integer(q));
+    }
+  }
+}
+
+TEST(correctness, expressions) {
+  using big_integer_expr::lazy;
+  std::default_random_engine rng(7);
+  std::uniform_int_distribution<int> bits(0, 2500);
+  auto random = [&]() {
+    big_integer x = (big_integer(1) << bits(rng)) - bits(rng) * 12345;
+    return bits(rng) % 2 == 0 ? -x : x;
+  };
+  for (int itn = 0; itn < 200; itn++) {
+    big_integer a = random(), b = random(), c = random(), d = random(), e = random(), r;
+    r = lazy(a) * b + lazy(c) * d - e;
+    EXPECT_EQ(a * b + c * d - e, r);
+    r = e - lazy(a) * b - c - (lazy(d) - a);
+    EXPECT_EQ(e - a * b - c - (d - a), r);
+    r = -(lazy(a) * a) + 3 * lazy(b) - lazy(c) * -5;
+    EXPECT_EQ(-(a * a) + 3 * b - c * -5, r);
+    r = (lazy(a) + b) * c * d + 1;
+    EXPECT_EQ((a + b) * c * d + 1, r);
+    // the terms may refer to the destination
+    r = lazy(r) * e - r + a;
+    EXPECT_EQ(((a + b) * c * d + 1) * e - ((a + b) * c * d + 1) + a, r);
+    EXPECT_EQ(a - a, big_integer(lazy(a) - a));
+  }
+
+  // short products are accumulated in place without allocating
+  big_integer a = (big_integer(1) << 500) - 1, b = -12345, c = big_integer(1) << 300, r = a * a;
+  size_t before = allocation_count;
+  r = lazy(a) * b + lazy(c) * c - a;
+  EXPECT_EQ(before, allocation_count);
+  EXPECT_EQ(a * b + c * c - a, r);
+
+  // nesting keeps the subexpressions by reference, so it copies nothing either
+  big_integer d = (big_integer(1) << 400) + 3, e = -(big_integer(1) << 700);
+  before = allocation_count;
+  r = lazy(a) * b + (lazy(c) * d - e);
+  EXPECT_EQ(before, allocation_count);
+  EXPECT_EQ(a * b + (c * d - e), r);
+  // an evaluated factor costs what evaluating it alone does, and is moved, not copied
+  before = allocation_count;
+  big_integer sum(lazy(a) + d);
+  size_t evaluation = allocation_count - before;
+  before = allocation_count;
+  r = (lazy(a) + d) * c + (lazy(c) * d - e);
+  EXPECT_EQ(before + evaluation, allocation_count);
+  EXPECT_EQ((a + d) * c + (c * d - e), r);
+}
+
+TEST(correctness, to_string_long) {
+  // the digits around the split points are zeros or nines, which the padding has to keep
+  for (size_t digits : {360, 361, 1000, 2304, 4608, 9999}) {
+    std::string ten(digits + 1, '0'), nines(digits, '9'), sparse(digits + 1, '0');
+    ten[0] = '1';
+    sparse[0] = sparse[digits / 2] = sparse[digits] = '7';
+    big_integer t(ten);
+    EXPECT_EQ(ten, to_string(t));
+    EXPECT_EQ(nines, to_string(t - 1));
+    EXPECT_EQ("-" + ten, to_string(-t));
+    EXPECT_EQ(sparse, to_string(big_integer(sparse)));
+  }
+}
+
+TEST(correctness, to_string_powers_cached) {
+  // a new thread starts with no powers; the second conversion of a number reuses them, and
+  // shorter numbers and other bases converted after it get the same digits
+  std::string ten(20000, '0'), ten_short(3000, '0');
+  ten[0] = ten_short[0] = '1';
+  big_integer t(ten), t_short(ten_short);
+  std::thread([&] {
+    size_t before = allocation_count;
+    EXPECT_EQ(ten, to_string(t));
+    size_t first = allocation_count - before;
+    before = allocation_count;
+    EXPECT_EQ(ten, to_string(t));
+    EXPECT_LT(allocation_count - before, first);
+    EXPECT_EQ(std::string(2999, '9'), to_string(t_short - 1));
+    EXPECT_EQ(to_string(big_integer_gmp(ten_short), 7), to_string(t_short, 7));
+    EXPECT_EQ(ten, to_string(t));
+  }).join();
+}
+
+TEST(correctness, string_ctor_long) {
+  // leading zeros of the whole string and of the low halves
+  for (size_t digits : {359, 360, 361, 1000, 2304, 4608, 9999}) {
+    std::string ten(digits + 1, '0');
+    ten[0] = '1';
+    big_integer t = 1;
+    for (size_t i = 0; i != digits; ++i) {
+      t *= 10;
+    }
+    EXPECT_EQ(t, big_integer(ten));
+    EXPECT_EQ(-t, big_integer("-" + ten));
+    EXPECT_EQ(t, big_integer("000" + ten));
+    EXPECT_EQ(t - 1, big_integer(std::string(digits, '9')));
+    EXPECT_EQ(t + 1, big_integer(std::string(ten, 0, digits) + "1"));
+  }
+  EXPECT_THROW(big_integer(std::string(5000, '1') + "x"), std::runtime_error);
+}
+
+TEST(correctness, string_ctor_invalid) {
+  EXPECT_THROW(big_integer(""), std::runtime_error);
+  EXPECT_THROW(big_integer("-"), std::runtime_error);
+  EXPECT_THROW(big_integer("--1"), std::runtime_error);
+  EXPECT_THROW(big_integer("+1"), std::runtime_error);
+  // a bad character at every position of 8- and 16-digit blocks and their tails
+  for (size_t pos = 0; pos != 45; ++pos) {
+    for (char c : {'/', ':', ' ', '\0', 'a', '\x80', '\xB0', '\xFF'}) {
+      std::string s(45, '5');
+      s[pos] = c;
+      EXPECT_THROW(big_integer{s}, std::runtime_error);
+    }
+  }
+}
+
+TEST(correctness, parse_chunk) {
+  char const *s = "12345678901234567890123";
+  size_t max_len = std::numeric_limits<big_integer::limb_t>::digits10;
+  for (size_t len = 0; len <= max_len; ++len) {
+    big_integer::limb_t expected = 0, all_nines = 0, value = 1;
+    for (size_t i = 0; i != len; ++i) {
+      expected = expected * 10 + (s[i] - '0');
+      all_nines = all_nines * 10 + 9;
+    }
+    EXPECT_TRUE(digits::parse_chunk(s, len, value));
+    EXPECT_EQ(expected, value);
+
+    std::string nines(len, '9'), zeros(len, '0');
+    EXPECT_TRUE(digits::parse_chunk(nines.data(), len, value));
+    EXPECT_EQ(all_nines, value);
+    EXPECT_TRUE(digits::parse_chunk(zeros.data(), len, value));
+    EXPECT_EQ(0u, value);
+
+    for (size_t pos = 0; pos != len; ++pos) {
+      std::string bad(s, len);
+      bad[pos] = pos % 2 == 0 ? '/' : ':';
+      EXPECT_FALSE(digits::parse_chunk(bad.data(), len, value));
+    }
+  }
+}
+
 namespace {
 size_t const number_of_iterations = 10;
 size_t const max_size = 2048;
@@ -690,9 +1284,129 @@ TEST(correctness, div_randomized) {
   }
 }
 
+TEST(correctness, mul_huge_halves) {
+  big_integer a = rand_big(8500);
+  big_integer b = rand_big(8500);
+  int half = 31 * 4000;
+  big_integer b_high = b >> half;
+  big_integer b_low = b - (b_high << half);
+  EXPECT_EQ(a * b_low + ((a * b_high) << half), a * b);
+  EXPECT_EQ(b * b_low + ((b * b_high) << half), b * b);
+}
+
 // y2019 tests
 
-TEST(correctness_random, cmp) {
+namespace limbs {
+void PrintTo(kernel_set set, std::ostream *os) {
+  *os << (set == kernel_set::portable ? "portable" : "bmi2_adx");
+}
+}
+
+// the differential tests run once for every kernel set the CPU supports
+class correctness_random : public ::testing::TestWithParam<limbs::kernel_set> {
+protected:
+  void SetUp() override {
+    saved = limbs::active_kernels();
+    ASSERT_TRUE(limbs::select_kernels(GetParam()));
+  }
+
+  void TearDown() override {
+    limbs::select_kernels(saved);
+  }
+
+private:
+  limbs::kernel_set saved;
+};
+
+std::vector<limbs::kernel_set> supported_kernel_sets() {
+  std::vector<limbs::kernel_set> res;
+  for (auto set : {limbs::kernel_set::portable, limbs::kernel_set::bmi2_adx}) {
+    if (limbs::kernel_supported(set)) {
+      res.push_back(set);
+    }
+  }
+  return res;
+}
+
+INSTANTIATE_TEST_CASE_P(kernels, correctness_random, ::testing::ValuesIn(supported_kernel_sets()));
+
+TEST_P(correctness_random, string_conv) {
+  std::default_random_engine rng(42);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a;
+    a.random(max_size << itn, rng);
+    big_integer A = big_integer(to_string(a));
+    EXPECT_EQ(to_string(a), to_string(A));
+    EXPECT_EQ(to_string(-a), to_string(-A));
+
+    big_integer_gmp b;
+    b.random(max_size << itn, rng);
+    EXPECT_EQ(to_string(a * b), to_string(big_integer(to_string(a * b))));
+  }
+}
+
+TEST_P(correctness_random, string_bases) {
+  std::default_random_engine rng(42);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a;
+    a.random(max_size << itn, rng);
+    big_integer A = big_integer(to_string(a));
+    for (int base : {2, 3, 7, 8, 10, 16, 32, 36}) {
+      std::string s = to_string(a, base);
+      EXPECT_EQ(s, to_string(A, base));
+      EXPECT_EQ(A, big_integer(s, base));
+    }
+  }
+}
+
+TEST_P(correctness_random, streams) {
+  std::default_random_engine rng(42);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a;
+    a.random(max_size << itn, rng);
+    std::string expected = to_string(a);
+    std::stringstream s(expected + " " + to_string(a, 16));
+    big_integer A, B;
+    s >> A >> std::hex >> B;
+    EXPECT_EQ(A, B);
+    std::ostringstream out;
+    out << A;
+    EXPECT_EQ(expected, out.str());
+  }
+}
+
+TEST_P(correctness_random, export_import) {
+  std::default_random_engine rng(42);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a;
+    a.random(max_size * (itn + 1), rng);
+    big_integer A = big_integer(to_string(a));
+    std::string hex = to_string(a < 0 ? -a : a, 16);
+
+    // one byte per word, most significant first, is the hex digits two at a time
+    std::vector<unsigned char> buf(export_size(A));
+    export_bytes(buf.data(), A);
+    EXPECT_EQ(big_integer(hex, 16), import_bytes(buf.data(), buf.size()));
+    if (hex != "0") {
+      EXPECT_EQ((hex.size() + 1) / 2, buf.size());
+      EXPECT_EQ(big_integer(hex.substr(0, 2 - hex.size() % 2), 16), buf[0]);
+    }
+
+    for (size_t word_size : {1, 3, 4, 8, 16}) {
+      for (word_order order : {word_order::most_significant_first,
+                               word_order::least_significant_first}) {
+        for (byte_order endian : {byte_order::big, byte_order::little, byte_order::native}) {
+          size_t count = export_size(A, word_size);
+          std::vector<unsigned char> words(count * word_size);
+          EXPECT_EQ(count, export_bytes(words.data(), A, word_size, order, endian));
+          EXPECT_EQ(A < 0 ? -A : A, import_bytes(words.data(), count, word_size, order, endian));
+        }
+      }
+    }
+  }
+}
+
+TEST_P(correctness_random, cmp) {
   std::default_random_engine rng(42);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a, b;
@@ -708,7 +1422,7 @@ TEST(correctness_random, cmp) {
   }
 }
 
-TEST(correctness_random, add) {
+TEST_P(correctness_random, add) {
   std::default_random_engine rng(42);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a, b;
@@ -720,7 +1434,7 @@ TEST(correctness_random, add) {
   }
 }
 
-TEST(correctness_random, sub) {
+TEST_P(correctness_random, sub) {
   std::default_random_engine rng(42);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a, b;
@@ -732,7 +1446,7 @@ TEST(correctness_random, sub) {
   }
 }
 
-TEST(correctness_random, mul) {
+TEST_P(correctness_random, mul) {
   std::default_random_engine rng(42);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a, b;
@@ -744,7 +1458,76 @@ TEST(correctness_random, mul) {
   }
 }
 
-TEST(correctness_random, div) {
+TEST_P(correctness_random, mul_long) {
+  std::default_random_engine rng(42);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a, b;
+    a.random(max_size * 16, rng);
+    b.random(max_size * (itn + 1), rng);
+    big_integer_gmp c = a * b;
+    big_integer R = big_integer(to_string(a)) * big_integer(to_string(b));
+    EXPECT_EQ(to_string(c), to_string(R));
+  }
+}
+
+TEST_P(correctness_random, mul_huge) {
+  std::default_random_engine rng(42);
+  for (size_t itn = 0; itn != 2; ++itn) {
+    big_integer_gmp a, b;
+    a.random(max_size * 32, rng);
+    b.random(max_size * (itn + 1) * 16, rng);
+    big_integer_gmp c = a * b;
+    big_integer R = big_integer(to_string(a)) * big_integer(to_string(b));
+    EXPECT_EQ(to_string(c), to_string(R));
+  }
+}
+
+TEST_P(correctness_random, mul_ntt) {
+  // both operands of at least NTT_THRESHOLD (6000) limbs, in either limb width: at the
+  // threshold, just past it, balanced, and with one operand several times the other
+  size_t const limb_bits = std::numeric_limits<big_integer::limb_t>::digits;
+  std::default_random_engine rng(42);
+  std::vector<std::pair<size_t, size_t>> shapes = {{6000, 6000}, {6001, 6000}, {9000, 8500},
+                                                   {30000, 6100}, {6050, 21000}};
+  for (auto const &shape : shapes) {
+    big_integer_gmp a, b;
+    a.random(shape.first * limb_bits - 1, rng);
+    b.random(shape.second * limb_bits - 1, rng);
+    big_integer A(to_string(a)), B(to_string(b));
+    ASSERT_LE(std::min(shape.first, shape.second), std::min(A.limbs().size, B.limbs().size));
+    EXPECT_EQ(to_string(a * b), to_string(A * B));
+    EXPECT_EQ(to_string(a * a), to_string(A * A));
+  }
+}
+
+TEST(correctness, mul_ntt_fits_boundary) {
+  // the shorter operand may have 2^22 32-bit coefficients; all ones give the largest
+  // convolution coefficients, which the three primes still restore exactly
+  size_t const limb_bits = std::numeric_limits<big_integer::limb_t>::digits;
+  size_t m = (static_cast<size_t>(1) << 22) / (limb_bits / 32);
+  EXPECT_TRUE(ntt_fits(m, m));
+  EXPECT_TRUE(ntt_fits(3 * m, m));
+  EXPECT_FALSE(ntt_fits(m + 1, m + 1));
+  big_integer a = (big_integer(1) << static_cast<int>(m * limb_bits)) - 1;
+  big_integer expected = (big_integer(1) << static_cast<int>(2 * m * limb_bits))
+                         - (big_integer(1) << static_cast<int>(m * limb_bits + 1)) + 1;
+  EXPECT_EQ(expected, a * a);
+}
+
+TEST_P(correctness_random, sqr) {
+  std::default_random_engine rng(42);
+  for (size_t sz = max_size / 64; sz <= max_size * 32; sz *= 2) {
+    big_integer_gmp a;
+    a.random(sz, rng);
+    big_integer_gmp c = a * a;
+    big_integer A = big_integer(to_string(a));
+    EXPECT_EQ(to_string(c), to_string(A * A));
+    A *= A;
+    EXPECT_EQ(to_string(c), to_string(A));
+  }
+}
+
+TEST_P(correctness_random, div) {
   std::default_random_engine rng(322);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a, b;
@@ -760,7 +1543,135 @@ TEST(correctness_random, div) {
   }
 }
 
-TEST(correctness_random, mod) {
+TEST_P(correctness_random, div_long) {
+  std::default_random_engine rng(322);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a, b;
+    a.random(max_size * 16, rng);
+    b.random(max_size * (itn + 1), rng);
+    big_integer A = big_integer(to_string(a)), B = big_integer(to_string(b));
+    EXPECT_EQ(to_string(a / b), to_string(A / B));
+    EXPECT_EQ(to_string(a % b), to_string(A % B));
+
+    // a multiple of b minus one needs the largest quotient corrections
+    big_integer_gmp c = a * b - 1;
+    big_integer C = A * B - 1;
+    EXPECT_EQ(to_string(c / b), to_string(C / B));
+    EXPECT_EQ(to_string(c % b), to_string(C % B));
+  }
+}
+
+TEST_P(correctness_random, div_newton) {
+  // a low threshold takes the reciprocal path and several levels of its Newton refinement
+  size_t saved_threshold = big_integer::div_newton_threshold;
+  big_integer::div_newton_threshold = 8;
+  std::default_random_engine rng(322);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a, b;
+    a.random(max_size * 16, rng);
+    b.random(max_size * (itn + 1), rng);
+    big_integer A = big_integer(to_string(a)), B = big_integer(to_string(b));
+    EXPECT_EQ(to_string(a / b), to_string(A / B));
+    EXPECT_EQ(to_string(a % b), to_string(A % B));
+
+    big_integer_gmp c = a * b - 1;
+    big_integer C = A * B - 1;
+    EXPECT_EQ(to_string(c / b), to_string(C / B));
+    EXPECT_EQ(to_string(c % b), to_string(C % B));
+  }
+  big_integer::div_newton_threshold = saved_threshold;
+}
+
+TEST_P(correctness_random, divmod) {
+  std::default_random_engine rng(322);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a, b;
+    a.random(max_size * 4, rng);
+    b.random(max_size * (itn + 1) / 4, rng);
+    big_integer A = big_integer(to_string(a)), B = big_integer(to_string(b));
+    auto qr = divmod(A, B);
+    EXPECT_EQ(to_string(a / b), to_string(qr.first));
+    EXPECT_EQ(to_string(a % b), to_string(qr.second));
+
+    big_integer rem;
+    A.divmod(B, rem);
+    EXPECT_EQ(to_string(a / b), to_string(A));
+    EXPECT_EQ(to_string(a % b), to_string(rem));
+  }
+}
+
+TEST_P(correctness_random, div_prepared) {
+  std::default_random_engine rng(322);
+  size_t saved_threshold = big_integer::div_newton_threshold;
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    // single-limb, schoolbook, recursive and (with a low threshold) Newton divisors
+    if (itn == number_of_iterations / 2) {
+      big_integer::div_newton_threshold = 8;
+    }
+    big_integer_gmp b;
+    b.random(itn % 4 == 0 ? 31 : max_size * (itn + 1) / 2, rng);
+    big_integer B = big_integer(to_string(b));
+    big_integer_divisor D(B);
+    for (size_t i = 0; i != 4; ++i) {
+      big_integer_gmp a;
+      a.random(max_size * (i + 1) * 4, rng);
+      big_integer A = big_integer(to_string(a));
+      EXPECT_EQ(to_string(a / b), to_string(A / D));
+      EXPECT_EQ(to_string(a % b), to_string(A % D));
+
+      auto qr = divmod(A * B - 1, D);
+      EXPECT_EQ(to_string((a * b - 1) / b), to_string(qr.first));
+      EXPECT_EQ(to_string((a * b - 1) % b), to_string(qr.second));
+    }
+  }
+  big_integer::div_newton_threshold = saved_threshold;
+}
+
+TEST_P(correctness_random, powm) {
+  std::default_random_engine rng(322);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp a, e, m;
+    a.random(max_size * 2, rng);
+    e.random(max_size / 4 * (itn % 3), rng);
+    m.random(max_size * (itn + 1) / number_of_iterations, rng);
+    if (e < 0) {
+      e = -e;
+    }
+    // odd moduli take the Montgomery path, even ones plain reduction
+    for (auto mod : {m, m + 1}) {
+      if (mod == 0) {
+        continue;
+      }
+      big_integer R = powm(big_integer(to_string(a)), big_integer(to_string(e)), big_integer(to_string(mod)));
+      EXPECT_EQ(to_string(powm(a, e, mod)), to_string(R));
+    }
+  }
+}
+
+TEST_P(correctness_random, barrett) {
+  std::default_random_engine rng(322);
+  for (size_t itn = 0; itn != number_of_iterations; ++itn) {
+    big_integer_gmp m;
+    m.random(max_size * (itn + 1) / 4, rng);
+    if (m == 0) {
+      continue;
+    }
+    big_integer M = big_integer(to_string(m));
+    big_integer_barrett ctx(M);
+    for (size_t i = 0; i != 8; ++i) {
+      // up to twice the length of the modulus, and (for the last ones) longer
+      big_integer_gmp x;
+      x.random(max_size * (itn + 1) / 4 * (i + 1) / 4, rng);
+      big_integer_gmp expected = x % m;
+      if (expected < 0) {
+        expected += m < 0 ? -m : m;
+      }
+      EXPECT_EQ(to_string(expected), to_string(ctx.reduce(big_integer(to_string(x)))));
+    }
+  }
+}
+
+TEST_P(correctness_random, mod) {
   std::default_random_engine rng(322);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a, b;
@@ -776,7 +1687,7 @@ TEST(correctness_random, mod) {
   }
 }
 
-TEST(correctness_random, bitwise) {
+TEST_P(correctness_random, bitwise) {
   std::default_random_engine rng(42);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a, b;
@@ -796,7 +1707,7 @@ TEST(correctness_random, bitwise) {
   }
 }
 
-TEST(correctness_random, bit_shifts) {
+TEST_P(correctness_random, bit_shifts) {
   std::default_random_engine rng(42);
   for (size_t itn = 0; itn != number_of_iterations; ++itn) {
     big_integer_gmp a;
@@ -809,6 +1720,18 @@ TEST(correctness_random, bit_shifts) {
   }
 }
 
+TEST_P(correctness_random, carry_chains) {
+  // all-ones operands carry through every limb, lengths cover the unrolled loops and their tails
+  for (int bits = 1; bits <= 1100; bits += 37) {
+    big_integer_gmp a = (big_integer_gmp(1) << bits) - 1;
+    big_integer A = (big_integer(1) << bits) - 1;
+    EXPECT_EQ(to_string(a + a), to_string(A + A));
+    EXPECT_EQ(to_string(a * a), to_string(A * A));
+    EXPECT_EQ(to_string(a * a - a), to_string(A * A - A));
+    EXPECT_EQ(to_string((a * a) / (a + 2)), to_string((A * A) / (A + 2)));
+  }
+}
+
 // TODO: extend due to idea
 TEST(correctness_twos_complement, simple) {
   std::string a = "-36893488147419103232"; // -(1 << 65)
@@ -44,7 +44,7 @@ struct cow_storage {
     }
   }
 
-  size_t get_use_count() noexcept {
+  size_t get_use_count() const noexcept {
     assert(counter > 0);
     return counter;
   }
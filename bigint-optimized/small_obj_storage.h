@@ -18,15 +18,23 @@ struct small_obj_storage {
   small_obj_storage() = default;
   small_obj_storage(const small_obj_storage &other);
   small_obj_storage& operator=(const small_obj_storage &other);
+  // the moved-from storage is left empty
+  small_obj_storage(small_obj_storage &&other) noexcept;
+  small_obj_storage& operator=(small_obj_storage &&other) noexcept;
   ~small_obj_storage();
 
   size_t size() const;
+  // the size it can grow to without allocating; a shared buffer has to be copied first
+  size_t capacity() const;
   void resize(size_t new_sz, const T &fill_value = T());
   void push_back(const T &val);
   void clear();
   const T& operator[](size_t id) const;
   T& operator[](size_t id);
+  const T* data() const;
+  T* data();
   const T& back() const;
+  void swap(small_obj_storage &other) noexcept;
 private:
   static constexpr size_t SMALL_OBJECT_SIZE = sizeof(cow_storage<T>*) / sizeof(T) + 1;
 
@@ -83,6 +91,28 @@ small_obj_storage<T>& small_obj_storage<T>::operator=(const small_obj_storage<T>
   return *this;
 }
 
+template<typename T>
+small_obj_storage<T>::small_obj_storage(small_obj_storage<T> &&other) noexcept
+  : small_obj_buff(other.small_obj_buff), promoted(other.promoted) {
+  other.small_obj_buff = {};
+  other.promoted = false;
+}
+
+template<typename T>
+small_obj_storage<T>& small_obj_storage<T>::operator=(small_obj_storage<T> &&other) noexcept {
+  if (&other == this) {
+    return *this;
+  }
+  if (promoted) {
+    small_obj_buff.dynamic_storage->dec_counter();
+  }
+  small_obj_buff = other.small_obj_buff;
+  promoted = other.promoted;
+  other.small_obj_buff = {};
+  other.promoted = false;
+  return *this;
+}
+
 template<typename T>
 size_t small_obj_storage<T>::size() const {
   return promoted ?
@@ -90,6 +120,15 @@ size_t small_obj_storage<T>::size() const {
   : small_obj_buff.static_storage.len;
 }
 
+template<typename T>
+size_t small_obj_storage<T>::capacity() const {
+  if (!promoted) {
+    return SMALL_OBJECT_SIZE;
+  }
+  cow_storage<T> const *ds = small_obj_buff.dynamic_storage;
+  return ds->get_use_count() == 1 ? ds->read_storage().capacity() : 0;
+}
+
 template<typename T>
 void small_obj_storage<T>::resize(size_t new_sz, const T &fill_value) {
   if (promoted) {
@@ -137,11 +176,36 @@ T& small_obj_storage<T>::operator[](size_t id) {
   }
 }
 
+template<typename T>
+const T* small_obj_storage<T>::data() const {
+  if (promoted) {
+    return small_obj_buff.dynamic_storage->read_storage().data();
+  } else {
+    return small_obj_buff.static_storage.buff;
+  }
+}
+
+template<typename T>
+T* small_obj_storage<T>::data() {
+  if (promoted) {
+    unshare();
+    return small_obj_buff.dynamic_storage->get_storage().data();
+  } else {
+    return small_obj_buff.static_storage.buff;
+  }
+}
+
 template<typename T>
 const T& small_obj_storage<T>::back() const {
   return (*this)[size() - 1];
 }
 
+template<typename T>
+void small_obj_storage<T>::swap(small_obj_storage<T> &other) noexcept {
+  std::swap(small_obj_buff, other.small_obj_buff);
+  std::swap(promoted, other.promoted);
+}
+
 template<typename T>
 small_obj_storage<T>::~small_obj_storage() {
   if (promoted) {
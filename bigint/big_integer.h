@@ -1,29 +1,80 @@
 #ifndef BIG_INTEGER_H
 #define BIG_INTEGER_H
 
+#include <iosfwd>
 #include <string>
 #include <cstdint>
 #include <vector>
 #include <functional>
+#include <utility>
+
+struct big_integer_divisor;
+namespace big_integer_expr {
+  template <typename E> struct expr;
+}
+
+// word and byte layouts for export_bytes and import_bytes
+enum class word_order { most_significant_first, least_significant_first };
+enum class byte_order { big, little, native };
 
 struct big_integer
 {
+#ifdef BIG_INTEGER_64BIT_LIMBS
+  typedef uint64_t limb_t;
+  __extension__ typedef unsigned __int128 dlimb_t;
+#else
   typedef uint32_t limb_t;
   typedef uint64_t dlimb_t;
+#endif
 
   big_integer();
   big_integer(big_integer const &other) = default;
+  // a moved-from big_integer may only be assigned to or destroyed
+  big_integer(big_integer &&other) noexcept;
   big_integer(int a);
+  // the magnitude from n limbs, least significant first
+  big_integer(limb_t const *limbs, size_t n, bool negative = false);
   explicit big_integer(std::string const &str);
+  // digits in base 2 <= base <= 36, with letters of either case from 10, after an optional '-';
+  // throws std::runtime_error if base is out of range or str is not such a number
+  explicit big_integer(std::string const &str, int base);
+  // the same from the characters [first, last)
+  big_integer(char const *first, char const *last, int base = 10);
   ~big_integer();
 
   big_integer& operator=(big_integer const &other) = default;
+  big_integer& operator=(big_integer &&other) noexcept;
+
+  // ***fused sums of products***
+  // +-a, or +-a * b if b is not null
+  struct sum_term
+  {
+    big_integer const *a;
+    big_integer const *b;
+    bool negative;
+  };
+  // *this = the sum of the n terms, computed in the buffer of *this: the numbers are summed in
+  // a single carry pass, and the products are accumulated row by row with addmul/submul
+  // (products of two long numbers are multiplied apart first); the terms may refer to *this
+  big_integer& assign_sum(sum_term const *terms, size_t n);
+  // the same for an expression of big_integer_expr.h, which defines these
+  template <typename E>
+  explicit big_integer(big_integer_expr::expr<E> const &e);
+  template <typename E>
+  big_integer& operator=(big_integer_expr::expr<E> const &e);
 
   big_integer& operator+=(big_integer const &rhs);
   big_integer& operator-=(big_integer const &rhs);
   big_integer& operator*=(big_integer const &rhs);
   big_integer& operator/=(big_integer const &rhs);
   big_integer& operator%=(big_integer const &rhs);
+  // *this /= rhs, and rem receives the remainder of the same division (rem must not be *this)
+  big_integer& divmod(big_integer const &rhs, big_integer &rem);
+
+  // the same operations with a divisor prepared in advance
+  big_integer& operator/=(big_integer_divisor const &rhs);
+  big_integer& operator%=(big_integer_divisor const &rhs);
+  big_integer& divmod(big_integer_divisor const &rhs, big_integer &rem);
 
   big_integer& operator&=(big_integer const &rhs);
   big_integer& operator|=(big_integer const &rhs);
@@ -32,9 +83,27 @@ struct big_integer
   big_integer& operator<<=(int rhs);
   big_integer& operator>>=(int rhs);
 
-  big_integer operator+() const;
-  big_integer operator-() const;
-  big_integer operator~() const;
+  // a read-only view of the limbs of |*this|, least significant first, without leading zero
+  // limbs (zero has a single one); valid until *this is changed or destroyed
+  struct limb_span {
+    limb_t const *data;
+    size_t size;
+
+    limb_t const *begin() const { return data; }
+    limb_t const *end() const { return data + size; }
+    limb_t operator[](size_t i) const { return data[i]; }
+  };
+  limb_span limbs() const;
+  // the number of limbs the buffer holds without reallocating
+  size_t capacity() const;
+
+  // the temporary forms reuse the buffer of *this
+  big_integer operator+() const &;
+  big_integer operator+() &&;
+  big_integer operator-() const &;
+  big_integer operator-() &&;
+  big_integer operator~() const &;
+  big_integer operator~() &&;
 
   big_integer& operator++();
   big_integer operator++(int);
@@ -49,35 +118,96 @@ struct big_integer
   friend bool operator<=(big_integer const &a, big_integer const &b);
   friend bool operator>=(big_integer const &a, big_integer const &b);
   friend std::string to_string(big_integer const& a);
+  friend char *to_chars(char *first, char *last, big_integer const &a, int base);
+  friend size_t to_chars_size(big_integer const &a, int base);
+  friend std::string to_string(big_integer const &a, int base);
+  friend std::ostream& operator<<(std::ostream &s, big_integer const &a);
+  friend std::istream& operator>>(std::istream &s, big_integer &a);
+  friend big_integer import_bytes(void const *in, size_t count, size_t word_size,
+                                  word_order order, byte_order endian);
+  friend std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b);
+  friend std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer_divisor const &b);
+  friend struct big_integer_divisor;
+  friend struct big_integer_montgomery;
+  friend struct big_integer_barrett;
+  friend big_integer powm(big_integer const &base, big_integer const &exp, big_integer const &mod);
+
+  // crossover point (in divisor limbs) from recursive division to division by
+  // a Newton reciprocal of the divisor; may be adjusted for tuning and tests
+  static size_t div_newton_threshold;
 
 private:
-  big_integer(limb_t a);
-  size_t len() const ;
-  limb_t rest_bits() const;
+  // sign-magnitude representation: data_ holds |*this| without leading zero limbs
+  // (zero is a single zero limb and is never negative)
+  size_t len() const;
   bool is_negative() const;
+  bool is_zero() const;
   void new_buffer(size_t new_size);
-  void make_positive();
-  big_integer& make_abs();
+  void normalize();
+
+  // addition and subtraction
+  int compare_magnitudes(big_integer const &rhs) const;
+  void add_signed(big_integer const &rhs, bool rhs_negative);
 
   // division and multiplication
-  void normalize();
-  void mul_short(limb_t short_factor);
-  void prefix(size_t len, big_integer &ans);
-  void add_on_pref(big_integer const &rhs, size_t at);
-  friend limb_t get_approx(big_integer const &a, big_integer const &b);
-  limb_t div_short(limb_t divisor);
+  void divide(big_integer const &rhs, big_integer &quot, big_integer &rem,
+              big_integer_divisor const *prepared = nullptr) const;
+
+  // string conversion
+  struct radix;
+  struct digit_sink;
+  bool parse_pow2(char const *first, char const *last, radix const &r);
+  bool parse_digits(char const *first, char const *last, radix const &r);
+  bool parse_digits(char const *first, char const *last, radix const &r,
+                    std::vector<big_integer> const &powers);
+  void from_chunks(limb_t const *c, size_t n, radix const &r,
+                   std::vector<big_integer> const &powers);
+  void write_pow2(digit_sink &sink, radix const &r) const;
+  void write_digits(digit_sink &sink, size_t width, radix const &r) const;
+  void write_digits(digit_sink &sink, size_t width, radix const &r,
+                    std::vector<big_integer_divisor> const &powers) const;
+  void write_number(digit_sink &sink, radix const &r, char const *prefix) const;
+  static std::vector<big_integer_divisor> const &chunk_powers(radix const &r, size_t n);
 
   // comparison
-  int compare_lexicographically(big_integer const &rhs, limb_t fill_value = 0, size_t at = 0) const;
   int compare_numerically(big_integer const &rhs) const;
 
-  // bitwise operations
+  // bitwise operations, they have two's complement semantics
+  std::vector<limb_t> to_twos_complement(size_t n) const;
+  void from_twos_complement(std::vector<limb_t> a);
   big_integer& bit_operation(
           big_integer const &rhs,
           const std::function<limb_t(limb_t, limb_t)> &f);
   big_integer& negate();
+
 private:
   std::vector<limb_t> data_;
+  bool negative_ = false;
+};
+
+// ***a divisor prepared for repeated division***
+// The divisor is scaled so that its top bit is set and its inverses are computed once,
+// so dividing many numbers by the same value skips that work on every division.
+struct big_integer_divisor
+{
+  // throws std::runtime_error if d is zero
+  explicit big_integer_divisor(big_integer const &d);
+
+  big_integer const &value() const;
+
+private:
+  friend struct big_integer;
+
+  big_integer value_;
+  // |value_| << shift_
+  std::vector<big_integer::limb_t> scaled_;
+  unsigned shift_;
+  // the 2-by-1 inverse of the scaled divisor if it is a single limb,
+  // the 3-by-2 inverse of its top two limbs otherwise
+  big_integer::limb_t inverse_;
+  // the Newton reciprocal of the scaled divisor, only for divisors of at least
+  // big_integer::div_newton_threshold limbs
+  std::vector<big_integer::limb_t> reciprocal_;
 };
 
 big_integer operator+(big_integer a, big_integer const &b);
@@ -85,14 +215,60 @@ big_integer operator-(big_integer a, big_integer const &b);
 big_integer operator*(big_integer a, big_integer const &b);
 big_integer operator/(big_integer a, big_integer const &b);
 big_integer operator%(big_integer a, big_integer const &b);
+// {a / b, a % b} from a single division
+std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b);
+big_integer operator/(big_integer a, big_integer_divisor const &b);
+big_integer operator%(big_integer a, big_integer_divisor const &b);
+std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer_divisor const &b);
 
 big_integer operator&(big_integer a, big_integer const &b);
 big_integer operator|(big_integer a, big_integer const &b);
 big_integer operator^(big_integer a, big_integer const &b);
 
+// the same with a temporary right operand: the result is computed in place in whichever
+// temporary operand has room for it, and only then in a copy of a
+big_integer operator+(big_integer const &a, big_integer &&b);
+big_integer operator+(big_integer &&a, big_integer &&b);
+big_integer operator-(big_integer const &a, big_integer &&b);
+big_integer operator-(big_integer &&a, big_integer &&b);
+big_integer operator&(big_integer const &a, big_integer &&b);
+big_integer operator&(big_integer &&a, big_integer &&b);
+big_integer operator|(big_integer const &a, big_integer &&b);
+big_integer operator|(big_integer &&a, big_integer &&b);
+big_integer operator^(big_integer const &a, big_integer &&b);
+big_integer operator^(big_integer &&a, big_integer &&b);
+
 big_integer operator<<(big_integer a, int b);
 big_integer operator>>(big_integer a, int b);
 
+// writes the decimal representation of a to [first, last), without a terminating null, and
+// returns the end of it, or nullptr if it does not fit; numbers shorter than a few dozen limbs
+// are written without allocating
+char *to_chars(char *first, char *last, big_integer const &a);
+// the same in base 2 <= base <= 36, with lowercase letters from 10
+char *to_chars(char *first, char *last, big_integer const &a, int base);
+// a buffer size with which to_chars writes a in place, at least its number of characters;
+// smaller buffers that fit the number are filled through a copy
+size_t to_chars_size(big_integer const &a, int base = 10);
+std::string to_string(big_integer const &a, int base);
+
+// ***binary import and export***
+// |a| is written as whole words of word_size bytes, with the given order of the words and of
+// the bytes in each word (as mpz_export does); the sign is not stored. The least significant
+// words first in native little-endian order is the layout of the limbs and is a plain copy.
+
+// the number of words |a| takes, 0 for zero
+size_t export_size(big_integer const &a, size_t word_size = 1);
+// writes export_size(a, word_size) words to out and returns their number
+size_t export_bytes(void *out, big_integer const &a, size_t word_size = 1,
+                    word_order order = word_order::most_significant_first,
+                    byte_order endian = byte_order::big);
+// the non-negative number written in the count words at in
+big_integer import_bytes(void const *in, size_t count, size_t word_size = 1,
+                         word_order order = word_order::most_significant_first,
+                         byte_order endian = byte_order::big);
+
 std::ostream& operator<<(std::ostream &s, big_integer const &a);
+std::istream& operator>>(std::istream &s, big_integer &a);
 
 #endif // BIG_INTEGER_H
@@ -0,0 +1,35 @@
+#ifndef BIG_INTEGER_BARRETT_H
+#define BIG_INTEGER_BARRETT_H
+
+#include <cstddef>
+#include "big_integer.h"
+
+// ***Barrett reduction modulo a fixed number***
+// For a k-limb modulus N, mu = B^2k / N is computed once. For 0 <= x < B^2k the quotient
+// x / N is then estimated as ((x / B^(k - 1)) * mu) / B^(k + 1), which is at most 2 too small,
+// so x mod N takes two multiplications and no division. Unlike Montgomery form,
+// any modulus works.
+
+struct big_integer_barrett
+{
+  // the modulus is |mod|; throws std::runtime_error if it is zero
+  explicit big_integer_barrett(big_integer const &mod);
+
+  big_integer const &modulus() const;
+
+  // x mod N, in [0, N); x with |x| >= B^2k are reduced by division
+  big_integer reduce(big_integer const &x) const;
+
+  // a * b mod N and a * a mod N, for 0 <= a, b < N
+  big_integer mulmod(big_integer const &a, big_integer const &b) const;
+  big_integer sqrmod(big_integer const &a) const;
+
+private:
+  big_integer modulus_;
+  // B^2k / N
+  big_integer mu_;
+  // the number of limbs of N
+  size_t k_;
+};
+
+#endif // BIG_INTEGER_BARRETT_H
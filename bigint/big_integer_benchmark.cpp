@@ -0,0 +1,53 @@
+// times the multiplication of random numbers of n limbs against GMP, through the NTT
+// from NTT_THRESHOLD limbs on; run big_integer_benchmark [max limbs]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "big_integer.h"
+#include "big_integer_gmp.h"
+
+namespace {
+  template <typename F>
+  double best_ms(int runs, F const &f) {
+    double best = 0;
+    for (int i = 0; i < runs; i++) {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+      best = i == 0 || t.count() < best ? t.count() : best;
+    }
+    return best;
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t max_limbs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  size_t const limb_bits = std::numeric_limits<big_integer::limb_t>::digits;
+  std::mt19937_64 rng(42);
+  std::printf("%10s %14s %14s %8s\n", "limbs", "big_integer ms", "gmp ms", "ratio");
+  for (size_t n = 1000; n <= max_limbs; n *= 10) {
+    for (size_t size : {n, 3 * n}) {
+      if (size > max_limbs) {
+        break;
+      }
+      std::vector<big_integer::limb_t> la(size), lb(size);
+      for (size_t i = 0; i < size; i++) {
+        la[i] = static_cast<big_integer::limb_t>(rng());
+        lb[i] = static_cast<big_integer::limb_t>(rng());
+      }
+      big_integer a(la.data(), size), b(lb.data(), size), c;
+      big_integer_gmp ga, gb, gc;
+      ga.random(size * limb_bits - 1, rng);
+      gb.random(size * limb_bits - 1, rng);
+      int runs = size < 100000 ? 5 : 1;
+      double ours = best_ms(runs, [&] { c = a * b; });
+      double gmp = best_ms(runs, [&] { gc = ga * gb; });
+      std::printf("%10zu %14.2f %14.2f %8.2f\n", size, ours, gmp, ours / gmp);
+    }
+  }
+}
@@ -0,0 +1,211 @@
+#ifndef BIG_INTEGER_EXPR_H
+#define BIG_INTEGER_EXPR_H
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include "big_integer.h"
+
+// ***expression templates***
+// An opt-in lazy form of +, - and *: with a, b, c, d and e numbers,
+//
+//   r = lazy(a) * b + lazy(c) * d - e;
+//
+// builds a tree of the operations that the assignment flattens into a list of terms for
+// big_integer::assign_sum, which evaluates them in the buffer of r without temporaries.
+// Products are of two numbers; other factors, like (lazy(a) + b) in (lazy(a) + b) * c,
+// are evaluated into a number first. An expression refers to its operands, including the
+// temporaries that ints are converted to, and its subexpressions by reference, so it has to
+// be evaluated in the full-expression that builds it and not kept (with auto, for example).
+
+namespace big_integer_expr {
+  template <typename E>
+  struct expr
+  {
+    E const &self() const {
+      return static_cast<E const &>(*this);
+    }
+  };
+
+  // a number taken by reference
+  struct ref : expr<ref>
+  {
+    static constexpr size_t size = 1;
+
+    explicit ref(big_integer const &x) : x(&x) {}
+
+    big_integer const *number() const {
+      return x;
+    }
+
+    void flatten(big_integer::sum_term *out, bool negative) const {
+      *out = {x, nullptr, negative};
+    }
+
+    big_integer const *x;
+  };
+
+  // a subexpression evaluated into a number, as a factor of a product
+  struct value : expr<value>
+  {
+    static constexpr size_t size = 1;
+
+    template <typename E>
+    explicit value(expr<E> const &e) : x(e) {}
+
+    big_integer const *number() const {
+      return &x;
+    }
+
+    void flatten(big_integer::sum_term *out, bool negative) const {
+      *out = {&x, nullptr, negative};
+    }
+
+    big_integer x;
+  };
+
+  // how a node keeps a subexpression: numbers by value, as they are made in the operators
+  // that build the node, and the rest by reference to the temporaries of the full-expression
+  template <typename E>
+  struct child
+  {
+    typedef E const &type;
+  };
+
+  template <>
+  struct child<ref>
+  {
+    typedef ref type;
+  };
+
+  // the factors are numbers, kept by value and moved in
+  template <typename A, typename B>
+  struct product : expr<product<A, B>>
+  {
+    static constexpr size_t size = 1;
+
+    product(A a, B b) : a(std::move(a)), b(std::move(b)) {}
+
+    void flatten(big_integer::sum_term *out, bool negative) const {
+      *out = {a.number(), b.number(), negative};
+    }
+
+    A a;
+    B b;
+  };
+
+  // l + r, or l - r if minus
+  template <typename L, typename R, bool minus>
+  struct sum : expr<sum<L, R, minus>>
+  {
+    static constexpr size_t size = L::size + R::size;
+
+    sum(L const &l, R const &r) : l(l), r(r) {}
+
+    void flatten(big_integer::sum_term *out, bool negative) const {
+      l.flatten(out, negative);
+      r.flatten(out + L::size, negative != minus);
+    }
+
+    typename child<L>::type l;
+    typename child<R>::type r;
+  };
+
+  template <typename E>
+  struct negation : expr<negation<E>>
+  {
+    static constexpr size_t size = E::size;
+
+    explicit negation(E const &e) : e(e) {}
+
+    void flatten(big_integer::sum_term *out, bool negative) const {
+      e.flatten(out, !negative);
+    }
+
+    typename child<E>::type e;
+  };
+
+  inline ref lazy(big_integer const &x) {
+    return ref(x);
+  }
+
+  // the type a factor of a product is kept as: numbers by reference, the rest evaluated
+  template <typename E>
+  struct factor
+  {
+    typedef value type;
+  };
+
+  template <>
+  struct factor<ref>
+  {
+    typedef ref type;
+  };
+
+  template <typename L, typename R>
+  product<typename factor<L>::type, typename factor<R>::type>
+  operator*(expr<L> const &l, expr<R> const &r) {
+    return {typename factor<L>::type(l.self()), typename factor<R>::type(r.self())};
+  }
+
+  template <typename L>
+  product<typename factor<L>::type, ref> operator*(expr<L> const &l, big_integer const &r) {
+    return {typename factor<L>::type(l.self()), ref(r)};
+  }
+
+  template <typename R>
+  product<ref, typename factor<R>::type> operator*(big_integer const &l, expr<R> const &r) {
+    return {ref(l), typename factor<R>::type(r.self())};
+  }
+
+  template <typename L, typename R>
+  sum<L, R, false> operator+(expr<L> const &l, expr<R> const &r) {
+    return {l.self(), r.self()};
+  }
+
+  template <typename L>
+  sum<L, ref, false> operator+(expr<L> const &l, big_integer const &r) {
+    return {l.self(), ref(r)};
+  }
+
+  template <typename R>
+  sum<ref, R, false> operator+(big_integer const &l, expr<R> const &r) {
+    return {ref(l), r.self()};
+  }
+
+  template <typename L, typename R>
+  sum<L, R, true> operator-(expr<L> const &l, expr<R> const &r) {
+    return {l.self(), r.self()};
+  }
+
+  template <typename L>
+  sum<L, ref, true> operator-(expr<L> const &l, big_integer const &r) {
+    return {l.self(), ref(r)};
+  }
+
+  template <typename R>
+  sum<ref, R, true> operator-(big_integer const &l, expr<R> const &r) {
+    return {ref(l), r.self()};
+  }
+
+  template <typename E>
+  negation<E> operator-(expr<E> const &e) {
+    return negation<E>(e.self());
+  }
+}
+
+template <typename E>
+big_integer::big_integer(big_integer_expr::expr<E> const &e)
+{
+  *this = e;
+}
+
+template <typename E>
+big_integer& big_integer::operator=(big_integer_expr::expr<E> const &e)
+{
+  std::array<sum_term, E::size> terms;
+  e.self().flatten(terms.data(), false);
+  return assign_sum(terms.data(), terms.size());
+}
+
+#endif // BIG_INTEGER_EXPR_H
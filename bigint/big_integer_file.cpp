@@ -0,0 +1,260 @@
+#include "big_integer_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  // a thread gets at least this many bytes of the file, so short files are converted by one
+  const size_t MIN_CHUNK_SIZE = 1 << 16;
+  const size_t HEADER_SIZE = 8;
+
+  void error(bool cond, std::string const &message) {
+    if (cond) {
+      throw std::runtime_error(message);
+    }
+  }
+
+  // an open file and its mapping, released in the destructor
+  struct mapped_file
+  {
+    int fd = -1;
+    char *data = nullptr;
+    size_t size = 0;
+
+    mapped_file() = default;
+    mapped_file(mapped_file const &) = delete;
+    mapped_file &operator=(mapped_file const &) = delete;
+
+    ~mapped_file() {
+      unmap();
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+
+    void map(int prot, int flags) {
+      void *p = mmap(nullptr, size, prot, flags, fd, 0);
+      error(p == MAP_FAILED, "cannot map the file");
+      data = static_cast<char *>(p);
+    }
+
+    void unmap() {
+      if (data != nullptr) {
+        munmap(data, size);
+        data = nullptr;
+      }
+    }
+  };
+
+  unsigned thread_count(unsigned requested, size_t bytes) {
+    unsigned n = requested != 0 ? requested : std::thread::hardware_concurrency();
+    n = std::max(n, 1u);
+    return static_cast<unsigned>(std::min<size_t>(n, std::max<size_t>(bytes / MIN_CHUNK_SIZE, 1)));
+  }
+
+  // runs f(0), ..., f(parts - 1) on separate threads (the last on this one) and rethrows
+  // the first exception any of them threw
+  template <typename F>
+  void run_parallel(unsigned parts, F const &f) {
+    std::vector<std::exception_ptr> errors(parts);
+    auto run = [&](unsigned k) {
+      try {
+        f(k);
+      } catch (...) {
+        errors[k] = std::current_exception();
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned k = 0; k + 1 < parts; k++) {
+      threads.emplace_back(run, k);
+    }
+    run(parts - 1);
+    for (std::thread &t : threads) {
+      t.join();
+    }
+    for (std::exception_ptr const &e : errors) {
+      if (e) {
+        std::rethrow_exception(e);
+      }
+    }
+  }
+
+  // splits the items with offsets[0, m] (offsets[m] is the total size) into parts runs
+  // of about the same size and returns the parts + 1 boundary indices
+  std::vector<size_t> split(std::vector<size_t> const &offsets, unsigned parts) {
+    size_t m = offsets.size() - 1;
+    std::vector<size_t> bounds(parts + 1, m);
+    bounds[0] = 0;
+    for (unsigned k = 1; k < parts; k++) {
+      size_t target = offsets[m] / parts * k;
+      bounds[k] = std::lower_bound(offsets.begin(), offsets.end(), target) - offsets.begin();
+      bounds[k] = std::min(std::max(bounds[k], bounds[k - 1]), m);
+    }
+    return bounds;
+  }
+
+  bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+  }
+
+  // calls f(first, last) for every whitespace-separated token of [first, last)
+  template <typename F>
+  void for_each_token(char const *first, char const *last, F &&f) {
+    while (true) {
+      while (first != last && is_space(*first)) {
+        first++;
+      }
+      if (first == last) {
+        return;
+      }
+      char const *token = first;
+      while (first != last && !is_space(*first)) {
+        first++;
+      }
+      f(token, first);
+    }
+  }
+
+  void open_file(mapped_file &file, std::string const &path, int flags) {
+    file.fd = open(path.c_str(), flags, 0644);
+    error(file.fd < 0, "cannot open " + path);
+  }
+
+  std::vector<big_integer> load_decimal(char const *text, size_t size, unsigned parts) {
+    // the chunks end at whitespace, so no number is split between two threads
+    std::vector<size_t> bounds(parts + 1, size);
+    bounds[0] = 0;
+    for (unsigned k = 1; k < parts; k++) {
+      size_t pos = std::max(size / parts * k, bounds[k - 1]);
+      while (pos < size && !is_space(text[pos])) {
+        pos++;
+      }
+      bounds[k] = pos;
+    }
+    std::vector<size_t> first_index(parts + 1, 0);
+    run_parallel(parts, [&](unsigned k) {
+      size_t count = 0;
+      for_each_token(text + bounds[k], text + bounds[k + 1],
+                     [&](char const *, char const *) { count++; });
+      first_index[k + 1] = count;
+    });
+    for (unsigned k = 0; k < parts; k++) {
+      first_index[k + 1] += first_index[k];
+    }
+    std::vector<big_integer> values(first_index[parts]);
+    run_parallel(parts, [&](unsigned k) {
+      size_t i = first_index[k];
+      for_each_token(text + bounds[k], text + bounds[k + 1],
+                     [&](char const *first, char const *last) {
+                       values[i++] = big_integer(first, last);
+                     });
+    });
+    return values;
+  }
+
+  std::vector<big_integer> load_binary(unsigned char const *data, size_t size, unsigned parts) {
+    // the headers chain the records, so they are walked once before the parallel part
+    std::vector<size_t> offsets;
+    for (size_t pos = 0; pos < size; ) {
+      error(size - pos < HEADER_SIZE, "load_file: truncated binary file");
+      uint64_t header = 0;
+      for (size_t j = HEADER_SIZE; j-- > 0; ) {
+        header = header << 8 | data[pos + j];
+      }
+      error(header / 2 > size - pos - HEADER_SIZE, "load_file: truncated binary file");
+      offsets.push_back(pos);
+      pos += HEADER_SIZE + static_cast<size_t>(header / 2);
+    }
+    offsets.push_back(size);
+    std::vector<big_integer> values(offsets.size() - 1);
+    std::vector<size_t> bounds = split(offsets, parts);
+    run_parallel(parts, [&](unsigned k) {
+      for (size_t i = bounds[k]; i < bounds[k + 1]; i++) {
+        unsigned char const *p = data + offsets[i];
+        values[i] = import_bytes(p + HEADER_SIZE, offsets[i + 1] - offsets[i] - HEADER_SIZE, 1,
+                                 word_order::least_significant_first, byte_order::little);
+        if (p[0] & 1) {
+          values[i] = -values[i];
+        }
+      }
+    });
+    return values;
+  }
+}
+
+std::vector<big_integer> load_file(std::string const &path, file_format format, unsigned threads) {
+  mapped_file file;
+  open_file(file, path, O_RDONLY);
+  struct stat st;
+  error(fstat(file.fd, &st) != 0, "cannot read " + path);
+  file.size = static_cast<size_t>(st.st_size);
+  if (file.size == 0) {
+    return std::vector<big_integer>();
+  }
+  file.map(PROT_READ, MAP_PRIVATE);
+  madvise(file.data, file.size, MADV_WILLNEED);
+  unsigned parts = thread_count(threads, file.size);
+  if (format == file_format::decimal) {
+    return load_decimal(file.data, file.size, parts);
+  }
+  return load_binary(reinterpret_cast<unsigned char const *>(file.data), file.size, parts);
+}
+
+void dump_file(std::string const &path, std::vector<big_integer> const &values,
+               file_format format, unsigned threads) {
+  mapped_file file;
+  open_file(file, path, O_RDWR | O_CREAT | O_TRUNC);
+  // binary records have their exact size; a decimal one gets to_chars_size characters, with
+  // which to_chars writes it straight into the map, and a newline, and the records are
+  // packed together after writing
+  bool binary = format == file_format::binary;
+  std::vector<size_t> offsets(values.size() + 1, 0);
+  for (size_t i = 0; i < values.size(); i++) {
+    size_t size = binary ? HEADER_SIZE + export_size(values[i]) : to_chars_size(values[i]) + 1;
+    offsets[i + 1] = offsets[i] + size;
+  }
+  file.size = offsets.back();
+  if (file.size == 0) {
+    return;
+  }
+  error(ftruncate(file.fd, static_cast<off_t>(file.size)) != 0, "cannot write " + path);
+  file.map(PROT_READ | PROT_WRITE, MAP_SHARED);
+  unsigned parts = thread_count(threads, file.size);
+  std::vector<size_t> bounds = split(offsets, parts);
+  std::vector<char *> ends(parts);
+  run_parallel(parts, [&](unsigned k) {
+    char *out = file.data + offsets[bounds[k]];
+    for (size_t i = bounds[k]; i < bounds[k + 1]; i++) {
+      if (binary) {
+        size_t bytes = export_bytes(out + HEADER_SIZE, values[i], 1,
+                                    word_order::least_significant_first, byte_order::little);
+        uint64_t header = static_cast<uint64_t>(bytes) * 2 + (values[i] < 0 ? 1 : 0);
+        for (size_t j = 0; j < HEADER_SIZE; j++, header >>= 8) {
+          out[j] = static_cast<char>(header & 0xff);
+        }
+        out += HEADER_SIZE + bytes;
+      } else {
+        out = to_chars(out, file.data + offsets[i + 1], values[i]);
+        *out++ = '\n';
+      }
+    }
+    ends[k] = out;
+  });
+  size_t length = ends[0] - file.data;
+  for (unsigned k = 1; k < parts; k++) {
+    size_t n = ends[k] - (file.data + offsets[bounds[k]]);
+    std::memmove(file.data + length, file.data + offsets[bounds[k]], n);
+    length += n;
+  }
+  file.unmap();
+  error(ftruncate(file.fd, static_cast<off_t>(length)) != 0, "cannot write " + path);
+}
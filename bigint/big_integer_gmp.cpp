@@ -184,7 +184,11 @@ bool operator>=(big_integer_gmp const& a, big_integer_gmp const& b) {
 }
 
 std::string to_string(big_integer_gmp const& a) {
-  char* tmp = mpz_get_str(NULL, 10, a.mpz);
+  return to_string(a, 10);
+}
+
+std::string to_string(big_integer_gmp const& a, int base) {
+  char* tmp = mpz_get_str(NULL, base, a.mpz);
   std::string res = tmp;
 
   void (* freefunc)(void*, size_t);
@@ -195,6 +199,12 @@ std::string to_string(big_integer_gmp const& a) {
   return res;
 }
 
+big_integer_gmp powm(big_integer_gmp const& base, big_integer_gmp const& exp, big_integer_gmp const& mod) {
+  big_integer_gmp res;
+  mpz_powm(res.mpz, base.mpz, exp.mpz, mod.mpz);
+  return res;
+}
+
 std::ostream& operator<<(std::ostream& s, big_integer_gmp const& a) {
   return s << to_string(a);
 }
\ No newline at end of file
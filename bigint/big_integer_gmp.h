@@ -59,6 +59,9 @@ struct big_integer_gmp {
   friend bool operator>=(big_integer_gmp const& a, big_integer_gmp const& b);
 
   friend std::string to_string(big_integer_gmp const& a);
+  friend std::string to_string(big_integer_gmp const& a, int base);
+  friend big_integer_gmp powm(big_integer_gmp const& base, big_integer_gmp const& exp,
+                              big_integer_gmp const& mod);
 
  private:
   mpz_t mpz;
@@ -85,6 +88,8 @@ bool operator<=(big_integer_gmp const& a, big_integer_gmp const& b);
 bool operator>=(big_integer_gmp const& a, big_integer_gmp const& b);
 
 std::string to_string(big_integer_gmp const& a);
+std::string to_string(big_integer_gmp const& a, int base);
+big_integer_gmp powm(big_integer_gmp const& base, big_integer_gmp const& exp, big_integer_gmp const& mod);
 std::ostream& operator<<(std::ostream& s, big_integer_gmp const& a);
 
 #endif // BIG_INTEGER_GMP_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef BIG_INTEGER_MONTGOMERY_H
+#define BIG_INTEGER_MONTGOMERY_H
+
+#include "big_integer.h"
+
+// ***Montgomery arithmetic modulo an odd number***
+// For an n-limb modulus N and R = B^n, x is represented by x * R mod N. A product of two
+// representations is brought back by REDC, t -> t / R mod N, which takes n multiplications
+// of the modulus by a single limb instead of a long division.
+
+struct big_integer_montgomery
+{
+  // the modulus is |mod|; throws std::runtime_error if it is even (or zero)
+  explicit big_integer_montgomery(big_integer const &mod);
+
+  big_integer const &modulus() const;
+
+  // x * R mod N, for any x
+  big_integer to_montgomery(big_integer const &x) const;
+  // x / R mod N, for 0 <= x < N
+  big_integer from_montgomery(big_integer const &x) const;
+
+  // a * b / R mod N and a * a / R mod N, for 0 <= a, b < N
+  big_integer mulmod(big_integer const &a, big_integer const &b) const;
+  big_integer sqrmod(big_integer const &a) const;
+
+private:
+  // t = t / R mod N, 0 <= t < N * R
+  void reduce(big_integer &t) const;
+
+  big_integer_divisor modulus_;
+  // R^2 mod N
+  big_integer r_squared_;
+  // -1 / N mod B
+  big_integer::limb_t n_inv_;
+};
+
+// base^exp mod |mod|, in [0, |mod|); odd moduli are handled in Montgomery form, even ones by
+// Barrett reduction. Throws std::runtime_error if mod is zero or exp is negative.
+big_integer powm(big_integer const &base, big_integer const &exp, big_integer const &mod);
+
+#endif // BIG_INTEGER_MONTGOMERY_H